@@ -1,15 +1,19 @@
 # SPDX-License-Identifier: Apache-2.0
 #
-# siesta_generate(TARGET <name> SCHEMA <path> [MODE CLIENT|SERVER|BOTH] [NO_PYTHON])
+# siesta_generate(TARGET <name> SCHEMA <path> [MODE CLIENT|SERVER|BOTH] [NO_PYTHON] [TYPED_HANDLERS] [COROUTINES] [IO_URING])
 #
 # Runs siesta-generator on the OpenAPI schema. Appends the generated C++
 # sources to <name> and creates nanobind modules for Python bindings.
 #
 # NO_PYTHON:        skip nanobind module generation and Python dependency checks
+# TYPED_HANDLERS:   server endpoints receive decoded, typed parameters and body
+# COROUTINES:       server endpoints are awaitable coroutines; the response is written on completion
+# IO_URING:         link siesta_uring (built with SIESTA_IO_URING) instead of siesta; generated into
+#                   its own directory, so the same schema can be built against both
 # REQUIRES:         find_package(siesta)
 
 function(siesta_generate)
-	cmake_parse_arguments(SG "NO_PYTHON" "TARGET;SCHEMA;MODE" "" ${ARGN})
+	cmake_parse_arguments(SG "NO_PYTHON;TYPED_HANDLERS;COROUTINES;IO_URING" "TARGET;SCHEMA;MODE" "" ${ARGN})
 
 	if(NOT SG_TARGET)
 		message(FATAL_ERROR "siesta_generate: TARGET is required")
@@ -39,9 +43,21 @@ function(siesta_generate)
 	else()
 		set(_siesta_lib siesta)
 	endif()
+	if(SG_IO_URING)
+		if(TARGET siesta::siesta_uring)
+			set(_siesta_lib siesta::siesta_uring)
+		elseif(TARGET siesta_uring)
+			set(_siesta_lib siesta_uring)
+		else()
+			message(FATAL_ERROR "siesta_generate: IO_URING requires siesta built with SIESTA_IO_URING=ON")
+		endif()
+	endif()
 
 	get_filename_component(_schema_name "${SG_SCHEMA}" NAME_WE)
 	set(_gen_dir "${CMAKE_CURRENT_BINARY_DIR}/siesta_gen/${_schema_name}")
+	if(SG_IO_URING)
+		string(APPEND _gen_dir "_uring")
+	endif()
 
 	set(_gen_mode "both")
 	if(SG_MODE STREQUAL "CLIENT")
@@ -84,6 +100,12 @@ function(siesta_generate)
 	if(SG_NO_PYTHON)
 		list(APPEND _gen_args "--no-python")
 	endif()
+	if(SG_TYPED_HANDLERS)
+		list(APPEND _gen_args "--typed-handlers")
+	endif()
+	if(SG_COROUTINES)
+		list(APPEND _gen_args "--coroutines")
+	endif()
 
 	add_custom_command(
 		OUTPUT ${_all_outputs}
@@ -67,15 +67,24 @@ void BeastClientGenerator::emitEndpoint(std::ostream& out, const Endpoint& ep) {
 		write_multiline_comment(out, text, "\t");
 	}
 
-	emitMethodSignature(out, ep);
+	emitMethodSignature(out, ep, false);
 	out << "\n\t{\n";
-	emitMethodBody(out, ep);
+	emitMethodBody(out, ep, false);
 	out << "\t}\n";
 	out << "\n";
+
+	// Same request; the response body is parsed into the schema type as it is read.
+	if (!ep.response_type.empty()) {
+		emitMethodSignature(out, ep, true);
+		out << "\n\t{\n";
+		emitMethodBody(out, ep, true);
+		out << "\t}\n";
+		out << "\n";
+	}
 }
 
-void BeastClientGenerator::emitMethodSignature(std::ostream& out, const Endpoint& ep) {
-	out << "\tauto " << ep.function_name << "(";
+void BeastClientGenerator::emitMethodSignature(std::ostream& out, const Endpoint& ep, bool typed) {
+	out << "\tauto " << ep.function_name << (typed ? "_typed(" : "(");
 
 	bool has_previous = false;
 
@@ -101,7 +110,12 @@ void BeastClientGenerator::emitMethodSignature(std::ostream& out, const Endpoint
 	if (has_previous) {
 		out << ", ";
 	}
-	out << "::boost::asio::completion_token_for<void(outcome_type)> auto&& token";
+	if (typed) {
+		out << "::boost::asio::completion_token_for<void(json_outcome_type<" << ep.response_type
+			<< ">)> auto&& token";
+	} else {
+		out << "::boost::asio::completion_token_for<void(outcome_type)> auto&& token";
+	}
 	out << ")";
 }
 
@@ -186,7 +200,7 @@ void BeastClientGenerator::emitHeaderParams(std::ostream& out, const std::vector
 	}
 }
 
-void BeastClientGenerator::emitMethodBody(std::ostream& out, const Endpoint& ep) {
+void BeastClientGenerator::emitMethodBody(std::ostream& out, const Endpoint& ep, bool typed) {
 	out << "\t\tconstexpr std::string_view path = \"" << escapeCppString(ep.path_template) << "\";\n";
 	out << "\t\trequest_type req;\n";
 
@@ -256,7 +270,11 @@ void BeastClientGenerator::emitMethodBody(std::ostream& out, const Endpoint& ep)
 	}
 	emitHeaderParams(out, header_params);
 
-	out << "\t\treturn this->async_submit_request(std::move(req), token);\n";
+	if (typed) {
+		out << "\t\treturn this->template async_submit_json<" << ep.response_type << ">(std::move(req), token);\n";
+	} else {
+		out << "\t\treturn this->async_submit_request(std::move(req), token);\n";
+	}
 }
 
 void BeastClientGenerator::generateClientHpp(std::ostream& out, const std::vector<Endpoint>& endpoints) {
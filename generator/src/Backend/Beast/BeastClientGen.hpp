@@ -24,8 +24,8 @@ public:
 private:
 	void emitClassHeader(std::ostream& out);
 	void emitEndpoint(std::ostream& out, const Endpoint& ep);
-	void emitMethodSignature(std::ostream& out, const Endpoint& ep);
-	void emitMethodBody(std::ostream& out, const Endpoint& ep);
+	void emitMethodSignature(std::ostream& out, const Endpoint& ep, bool typed);
+	void emitMethodBody(std::ostream& out, const Endpoint& ep, bool typed);
 	void generateClientHpp(std::ostream& out, const std::vector<Endpoint>& endpoints);
 
 	void emitPathParams(std::ostream& out, const std::vector<const ClientParam*>& path_params);
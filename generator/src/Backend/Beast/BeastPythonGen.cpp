@@ -195,6 +195,18 @@ void BeastPythonGenerator::emitModuleBody(std::ostream& out, const std::vector<E
 	out << "\t\tclient->start(boost::asio::ip::make_address(host), port);\n";
 	out << "\t\tctx.run();\n";
 	out << "\t}\n";
+	// Connects over a UNIX domain socket instead; exposed to Python as Client.unix(path).
+	out << "\tstruct unix_socket_t {};\n";
+	if (auth_type != AuthType::None) {
+		out << "\tClientWrapper(unix_socket_t, std::string path, std::string " << auth_param_name << ")\n";
+		out << "\t\t: client(std::make_shared<" << ns_ << "::Client>(ctx, std::move(" << auth_param_name << "))) {\n";
+	} else {
+		out << "\tClientWrapper(unix_socket_t, std::string path)\n";
+		out << "\t\t: client(std::make_shared<" << ns_ << "::Client>(ctx)) {\n";
+	}
+	out << "\t\tclient->start(boost::asio::local::stream_protocol::endpoint(path));\n";
+	out << "\t\tctx.run();\n";
+	out << "\t}\n";
 	out << "\t~ClientWrapper() { client->stop(); }\n";
 	out << "\tauto& context() { return ctx; }\n";
 	out << "\tvoid start(std::string host, uint16_t port) {\n";
@@ -203,6 +215,12 @@ void BeastPythonGenerator::emitModuleBody(std::ostream& out, const std::vector<E
 	out << "\t\tctx.restart();\n";
 	out << "\t\tctx.run();\n";
 	out << "\t}\n";
+	out << "\tvoid start_unix(std::string path) {\n";
+	out << "\t\tclient->stop();\n";
+	out << "\t\tclient->start(boost::asio::local::stream_protocol::endpoint(path));\n";
+	out << "\t\tctx.restart();\n";
+	out << "\t\tctx.run();\n";
+	out << "\t}\n";
 	out << "\tvoid stop() { client->stop(); }\n";
 	out << "};\n";
 	out << "\n";
@@ -220,7 +238,19 @@ void BeastPythonGenerator::emitModuleBody(std::ostream& out, const std::vector<E
 		out << "\t\t.def(nb::init<std::string, uint16_t>(), nb::arg(\"host\") = std::string(\"localhost\"), "
 			   "nb::arg(\"port\") = 443)\n";
 	}
+	if (auth_type != AuthType::None) {
+		out << "\t\t.def_static(\"unix\", [](std::string path, std::string " << auth_param_name << ") {\n";
+		out << "\t\t\treturn new ClientWrapper(ClientWrapper::unix_socket_t{}, std::move(path), std::move("
+			<< auth_param_name << "));\n";
+		out << "\t\t}, nb::arg(\"path\"), nb::arg(\"" << auth_param_name
+			<< "\") = std::string(\"\"), nb::rv_policy::take_ownership)\n";
+	} else {
+		out << "\t\t.def_static(\"unix\", [](std::string path) {\n";
+		out << "\t\t\treturn new ClientWrapper(ClientWrapper::unix_socket_t{}, std::move(path));\n";
+		out << "\t\t}, nb::arg(\"path\"), nb::rv_policy::take_ownership)\n";
+	}
 	out << "\t\t.def(\"start\", &ClientWrapper::start, nb::arg(\"host\"), nb::arg(\"port\"))\n";
+	out << "\t\t.def(\"start_unix\", &ClientWrapper::start_unix, nb::arg(\"path\"))\n";
 	out << "\t\t.def(\"stop\", &ClientWrapper::stop)\n";
 
 	for (size_t i = 0; i < endpoints.size(); ++i) {
@@ -5,8 +5,296 @@
 #include "Frontend/openapi3.hpp"
 #include <algorithm>
 #include <fstream>
+#include <map>
+#include <memory>
 
 namespace codegen {
+namespace {
+
+// One path segment of the routing trie. Templated segments ("{name}") share a single param child.
+struct RouteNode {
+	std::map<std::string, std::unique_ptr<RouteNode>> statics;
+	std::unique_ptr<RouteNode> param;
+	std::vector<const Endpoint*> endpoints;
+};
+
+bool isParamSegment(std::string_view seg) {
+	return seg.size() >= 2 && seg.front() == '{' && seg.back() == '}';
+}
+
+RouteNode buildRouteTrie(const std::vector<Endpoint>& endpoints) {
+	RouteNode root;
+	for (const auto& ep : endpoints) {
+		RouteNode* node = &root;
+		std::string_view path = ep.path;
+		while (!path.empty() && path.front() == '/') {
+			path.remove_prefix(1);
+			const auto cut = path.find('/');
+			const auto seg = path.substr(0, cut);
+			path = cut == std::string_view::npos ? std::string_view() : path.substr(cut);
+			auto& child = isParamSegment(seg) ? node->param : node->statics[std::string(seg)];
+			if (!child) {
+				child = std::make_unique<RouteNode>();
+			}
+			node = child.get();
+		}
+		node->endpoints.push_back(&ep);
+	}
+	return root;
+}
+
+// Emits the matcher for `node`, the trie node reached after `level` segments, `captured` of them templated.
+// `rest` names the unmatched remainder of the path; a segment is only split off it when it starts with '/',
+// so a target that does not, such as an absolute-form or asterisk-form one, matches nothing. A branch that
+// fails to match falls through to the next alternative, so static children are always tried before the
+// param child and a dead end backtracks into its parent. Param segments are recorded into `captures` by
+// position; a backtracked capture is simply overwritten by the next candidate.
+void emitRouteNode(std::ostream& out, const RouteNode& node, const std::string& rest, int level, int captured,
+                   int depth) {
+	const std::string indent(depth + 1, '\t');
+	if (!node.endpoints.empty()) {
+		out << indent << "if (" << rest << ".empty()) {\n";
+		out << indent << "\tswitch (method) {\n";
+		for (const auto* ep : node.endpoints) {
+			out << indent << "\tcase http::verb::" << ep->cpp_verb << ": return Route::" << ep->function_name << ";\n";
+		}
+		out << indent << "\tdefault: break;\n";
+		out << indent << "\t}\n";
+		out << indent << "}\n";
+	}
+	if (node.statics.empty() && !node.param) {
+		return;
+	}
+
+	const auto d = std::to_string(level);
+	const auto seg = "seg" + d;
+	const auto next = "rest" + d;
+	out << indent << "if (" << rest << ".starts_with('/')) {\n";
+	out << indent << "\tconst auto cut" << d << " = " << rest << ".find('/', 1);\n";
+	out << indent << "\tconst auto " << seg << " = " << rest << ".substr(1, cut" << d << " - 1);\n";
+	out << indent << "\tconst auto " << next << " = cut" << d << " == std::string_view::npos ? \"\"sv : " << rest
+		<< ".substr(cut" << d << ");\n";
+
+	if (!node.statics.empty()) {
+		// Dispatch on segment length first, then compare the handful of candidates of that length.
+		std::map<std::size_t, std::vector<const std::pair<const std::string, std::unique_ptr<RouteNode>>*>> by_size;
+		for (const auto& entry : node.statics) {
+			by_size[entry.first.size()].push_back(&entry);
+		}
+		out << indent << "\tswitch (" << seg << ".size()) {\n";
+		for (const auto& [size, entries] : by_size) {
+			out << indent << "\tcase " << size << ":\n";
+			for (const auto* entry : entries) {
+				out << indent << "\t\tif (" << seg << " == \"" << escapeCppString(entry->first) << "\"sv) {\n";
+				emitRouteNode(out, *entry->second, next, level + 1, captured, depth + 3);
+				out << indent << "\t\t}\n";
+			}
+			out << indent << "\t\tbreak;\n";
+		}
+		out << indent << "\tdefault: break;\n";
+		out << indent << "\t}\n";
+	}
+	if (node.param) {
+		out << indent << "\tif (!" << seg << ".empty()) {\n";
+		out << indent << "\t\tcaptures[" << captured << "] = " << seg << ";\n";
+		emitRouteNode(out, *node.param, next, level + 1, captured + 1, depth + 2);
+		out << indent << "\t}\n";
+	}
+	out << indent << "}\n";
+}
+
+// Type of a decoded parameter as the typed handler receives it.
+std::string handlerParamType(const ClientParam& p) {
+	return p.required ? p.cpp_type : "std::optional<" + p.cpp_type + ">";
+}
+
+// Boolean expression that parses `src`, already decoded, into the decoder local for `p` (appending, for
+// arrays).
+std::string parseInto(const ClientParam& p, const std::string& src) {
+	// Array items are held as JSON values in the IR; query and header items are taken as strings.
+	if (p.cpp_type == "std::vector<boost::json::value>") {
+		return "(p_" + p.name + ".emplace_back(std::string_view(" + src + ")), true)";
+	}
+	return "parse_value(" + src + ", p_" + p.name + (p.is_vector_type ? ".emplace_back())" : ".emplace())");
+}
+
+// Call to an endpoint virtual with the given trailing arguments. Coroutine endpoints are handed to
+// Session::spawn. Offloaded endpoints are handed to ServerBase::offload, plain ones wrapped in a lambda
+// that owns the arguments.
+std::string handlerCall(const Endpoint& ep, const ServerOptions& options, const std::string& object,
+                        const std::vector<std::string>& args) {
+	std::string call;
+	if (options.coroutines) {
+		call = object + ep.function_name + "(req, session->get_response()";
+		for (const auto& arg : args) {
+			call += ", " + arg;
+		}
+		call += ")";
+		return (ep.offload ? object + "offload(session, " : "session->spawn(") + call + ")";
+	}
+	if (!ep.offload) {
+		call = object + ep.function_name + "(req, std::move(session)";
+		for (const auto& arg : args) {
+			call += ", " + arg;
+		}
+		return call + ")";
+	}
+	const std::string self = object.empty() ? "this" : "&" + object.substr(0, object.size() - 1);
+	call = object + "offload(session, [" + self + ", &req, session";
+	for (std::size_t i = 0; i < args.size(); ++i) {
+		call += ", a" + std::to_string(i) + " = " + args[i];
+	}
+	call += "]() mutable { " + object + ep.function_name + "(req, std::move(session)";
+	for (std::size_t i = 0; i < args.size(); ++i) {
+		call += ", std::move(a" + std::to_string(i) + ")";
+	}
+	return call + "); })";
+}
+
+// Emits the typed decoder for `ep`: parses the body, the query string (in one pass), headers and router
+// captures into locals, answers 400 on missing or malformed input, and calls the typed virtual.
+void emitDecoder(std::ostream& out, const Endpoint& ep, const ServerOptions& options) {
+	out << "void decode__" << ep.function_name
+		<< "(Server& server, Server::request& req, Server::Session::Ptr session, std::string_view query";
+	for (std::size_t i = 0; i < ep.path_captures.size(); ++i) {
+		out << ", std::string_view path" << i;
+	}
+	out << ") {\n";
+
+	std::vector<const ClientParam*> query_params;
+	for (const auto& p : ep.params) {
+		if (p.location == "query") query_params.push_back(&p);
+	}
+
+	if (ep.has_request_body) {
+		out << "\tstd::optional<" << ep.body_type << "> p__body;\n";
+		if (ep.body_type == "std::string") {
+			out << "\tp__body.emplace(req.body());\n";
+		} else {
+			// Parsed by the decoder body_decoder() installed while the body was read.
+			out << "\tif (auto* decoder = session->decoder()) {\n";
+			out << "\t\tauto& json = static_cast<::siesta::beast::json_decoder<" << ep.body_type << ">&>(*decoder);\n";
+			out << "\t\tif (json.ok()) {\n";
+			out << "\t\t\tp__body.emplace(std::move(json.value()));\n";
+			out << "\t\t}\n";
+			out << "\t}\n";
+			out << "\tif (!p__body) {\n";
+			out << "\t\treturn bad_request(session, \"invalid request body\");\n";
+			out << "\t}\n";
+		}
+	}
+	for (const auto& p : ep.params) {
+		if (p.is_vector_type) {
+			out << "\t" << p.cpp_type << " p_" << p.name << ";\n";
+		} else {
+			out << "\tstd::optional<" << p.cpp_type << "> p_" << p.name << ";\n";
+		}
+	}
+
+	for (const auto& p : ep.params) {
+		if (p.location != "path") continue;
+		auto it = std::find_if(ep.path_captures.begin(), ep.path_captures.end(), [&](const ClientParam& c) {
+			return c.wire_name == p.wire_name;
+		});
+		if (it == ep.path_captures.end()) continue;
+		const auto path = "path" + std::to_string(it - ep.path_captures.begin());
+		out << "\tif (!" << parseInto(p, "::siesta::url_decode(" + path + ")") << ") {\n";
+		out << "\t\treturn bad_request(session, \"invalid path parameter '" << escapeCppString(p.wire_name) << "'\");\n";
+		out << "\t}\n";
+	}
+
+	if (!query_params.empty()) {
+		out << "\tconst bool query_ok = ::siesta::for_each_query_param(query, [&](std::string_view key, std::string_view value) {\n";
+		for (const auto* p : query_params) {
+			out << "\t\tif (key == \"" << escapeCppString(p->wire_name) << "\"sv) return "
+				<< parseInto(*p, "::siesta::url_decode(value, true)")
+				<< ";\n";
+		}
+		out << "\t\treturn true;\n";
+		out << "\t});\n";
+		out << "\tif (!query_ok) {\n";
+		out << "\t\treturn bad_request(session, \"invalid query parameter\");\n";
+		out << "\t}\n";
+	}
+
+	for (const auto& p : ep.params) {
+		if (p.location != "header") continue;
+		out << "\tif (auto it = req.find(\"" << escapeCppString(p.wire_name) << "\"); it != req.end()) {\n";
+		if (p.is_string_type && !p.is_vector_type) {
+			out << "\t\tp_" << p.name << ".emplace(it->value());\n";
+		} else {
+			out << "\t\tif (!" << parseInto(p, "it->value()") << ") {\n";
+			out << "\t\t\treturn bad_request(session, \"invalid header '" << escapeCppString(p.wire_name) << "'\");\n";
+			out << "\t\t}\n";
+		}
+		out << "\t}\n";
+	}
+
+	for (const auto& p : ep.params) {
+		if (!p.required || p.is_vector_type) continue;
+		if (p.location == "path" && std::none_of(ep.path_captures.begin(), ep.path_captures.end(),
+		                                         [&](const ClientParam& c) { return c.wire_name == p.wire_name; })) {
+			// Not a whole path segment, so the router cannot capture it; the handler gets a default value.
+			out << "\tp_" << p.name << ".emplace();\n";
+			continue;
+		}
+		out << "\tif (!p_" << p.name << ") {\n";
+		out << "\t\treturn bad_request(session, \"missing " << p.location << " parameter '"
+			<< escapeCppString(p.wire_name) << "'\");\n";
+		out << "\t}\n";
+	}
+
+	std::vector<std::string> args;
+	if (ep.has_request_body) {
+		args.push_back("std::move(*p__body)");
+	}
+	for (const auto& p : ep.params) {
+		if (p.is_vector_type && !p.required) {
+			args.push_back("p_" + p.name + ".empty() ? std::nullopt : std::make_optional(std::move(p_" + p.name + "))");
+		} else if (p.is_vector_type || !p.required) {
+			args.push_back("std::move(p_" + p.name + ")");
+		} else {
+			args.push_back("std::move(*p_" + p.name + ")");
+		}
+	}
+	out << "\t" << handlerCall(ep, options, "server.", args) << ";\n";
+	out << "}\n";
+	out << "\n";
+}
+
+bool hasBodyLimits(const std::vector<Endpoint>& endpoints) {
+	return std::any_of(endpoints.begin(), endpoints.end(), [](const Endpoint& ep) { return ep.body_limit != 0; });
+}
+
+// Whether the typed decoder takes `ep`'s body as JSON, parsed while it is read.
+bool hasJsonBodies(const std::vector<Endpoint>& endpoints, const ServerOptions& options) {
+	return std::any_of(endpoints.begin(), endpoints.end(), [&](const Endpoint& ep) {
+		return decodesJsonBody(ep, options);
+	});
+}
+
+} // anonymous namespace
+
+bool decodesJsonBody(const Endpoint& ep, const ServerOptions& options) {
+	return options.typed_handlers && ep.has_request_body && ep.body_type != "std::string";
+}
+
+std::vector<std::pair<std::string, std::string>> handlerParams(const Endpoint& ep, const ServerOptions& options) {
+	std::vector<std::pair<std::string, std::string>> params;
+	if (!options.typed_handlers) {
+		for (const auto& cp : ep.path_captures) {
+			params.emplace_back("std::string_view", cp.name);
+		}
+		return params;
+	}
+	if (ep.has_request_body) {
+		params.emplace_back(ep.body_type, "body");
+	}
+	for (const auto& p : ep.params) {
+		params.emplace_back(handlerParamType(p), p.name);
+	}
+	return params;
+}
 
 void BeastServerGenerator::operator()(const CodegenArgs& args, const std::filesystem::path& output_dir) {
 	if (!args.spec || !args.endpoints || args.endpoints->empty()) {
@@ -15,6 +303,7 @@ void BeastServerGenerator::operator()(const CodegenArgs& args, const std::filesy
 
 	const auto& endpoints = *args.endpoints;
 	ns_ = args.ns;
+	options_ = args.server;
 
 	std::filesystem::create_directories(output_dir);
 	{
@@ -39,10 +328,15 @@ void BeastServerGenerator::emitServerHpp(std::ostream& out, const std::vector<En
 	out << "#include <boost/asio/ip/tcp.hpp>\n";
 	out << "#include <boost/beast/core.hpp>\n";
 	out << "#include <boost/beast/http.hpp>\n";
+	out << "#include <array>\n";
+	out << "#include <cstdint>\n";
 	out << "#include <functional>\n";
 	out << "#include <memory>\n";
+	out << "#include <optional>\n";
+	out << "#include <span>\n";
 	out << "#include <string>\n";
 	out << "#include <string_view>\n";
+	out << "#include <vector>\n";
 	out << "\n";
 	out << "#include \"" << filenames::DEFS_HPP << "\"\n";
 	out << "#include <siesta/beast/server.hpp>\n";
@@ -55,15 +349,56 @@ void BeastServerGenerator::emitServerHpp(std::ostream& out, const std::vector<En
 	out << "\tusing ::siesta::beast::ServerBase::ServerBase;\n";
 	out << "\tusing ::siesta::beast::ServerBase::Session;\n";
 	out << "\tusing request = ::siesta::beast::ServerBase::request;\n";
+	out << "\tusing response = ::siesta::beast::ServerBase::response;\n";
+	out << "\n";
+	out << "\t// Endpoints known to the router.\n";
+	out << "\tenum class Route : uint16_t {\n";
+	out << "\t\tnone,\n";
+	for (const auto& ep : endpoints) {
+		out << "\t\t" << ep.function_name << ",\n";
+	}
+	out << "\t};\n";
+	out << "\n";
+	std::size_t max_captures = 0;
+	for (const auto& ep : endpoints) {
+		max_captures = std::max(max_captures, ep.path_captures.size());
+	}
+	out << "\t// Templated path segments matched by route(), in path order. Views into the request target.\n";
+	out << "\tusing Captures = std::array<std::string_view, " << max_captures << ">;\n";
 	out << "\n";
-	out << "\tvoid handle_request(const request, Session::Ptr) final;\n";
+	out << "\t// Resolves a request path (without query string) and method to an endpoint in a single pass over\n";
+	out << "\t// the path, capturing templated segments along the way. Static segments take precedence over\n";
+	out << "\t// templated ones.\n";
+	out << "\tstatic Route route(std::string_view path, ::boost::beast::http::verb method, Captures& captures) noexcept;\n";
+	out << "\n";
+	out << "\t// Routes a request once its header is parsed: a Route, and its Captures kept in the arena.\n";
+	out << "\tResolution resolve(const request_header&, std::pmr::memory_resource&) const final;\n";
+	out << "\tvoid handle_request(request&, Session::Ptr) final;\n";
+	out << "\t// Endpoint names metrics are kept under, indexed by Route.\n";
+	out << "\tstd::span<const std::string_view> endpoint_names() const noexcept final;\n";
+	if (hasBodyLimits(endpoints)) {
+		out << "\t// Per-endpoint request body limits (\"x-siesta-body-limit\"), consulted once the header is parsed.\n";
+		out << "\tstd::uint64_t body_limit(const request_header&, const Resolution&) const override;\n";
+	}
+	if (hasJsonBodies(endpoints, options_)) {
+		out << "\t// Decoders parsing JSON request bodies into their endpoint's type while they are read.\n";
+		out << "\tBodyDecoder* body_decoder(request_header&, const Resolution&, std::pmr::memory_resource&) const final;\n";
+	}
 	out << "\n";
 
 	for (const auto& ep : endpoints) {
 		if (!ep.summary.empty()) {
 			write_multiline_comment(out, ep.summary, "\t");
 		}
-		out << "\tvirtual void " << ep.function_name << "(const request, Session::Ptr) = 0;\n";
+		if (options_.coroutines) {
+			out << "\tvirtual ::boost::asio::awaitable<void> " << ep.function_name << "(request&, response&";
+		} else {
+			out << "\tvirtual void " << ep.function_name << "(request&, Session::Ptr";
+		}
+		for (const auto& [type, name] : handlerParams(ep, options_)) {
+			out << ", " << type << " " << name;
+		}
+		out << ") = 0;\n";
 		out << "\n";
 	}
 
@@ -76,97 +411,153 @@ void BeastServerGenerator::emitServerCpp(std::ostream& out, const std::vector<En
 	out << "#include \"server.hpp\"\n";
 	out << "\n";
 	out << "#include <string_view>\n";
-	out << "#include <unordered_map>\n";
 	out << "#include <utility>\n";
+	if (options_.typed_handlers) {
+		out << "\n";
+		out << "#include <siesta/beast/json_decoder.hpp>\n";
+	}
 	out << "\n";
 	out << "namespace http = ::boost::beast::http;\n";
 	out << "using std::literals::string_view_literals::operator\"\"sv;\n";
 	out << "\n";
 	out << "namespace " << ns_ << " {\n";
-	out << "namespace {\n";
-	out << "\n";
-	out << "using fnptr_t = void (Server::*)(const Server::request, Server::Session::Ptr);\n";
 	out << "\n";
 
-	std::vector<const Endpoint*> static_eps;
-	std::vector<const Endpoint*> param_eps;
+	out << "namespace {\n";
+	out << "\n";
+	out << "// Header lines sent with every response of an endpoint, pre-rendered so that the session\n";
+	out << "// writes them as-is instead of inserting and re-serializing fields.\n";
 	for (const auto& ep : endpoints) {
-		if (ep.path_template.find("{}") != std::string::npos) {
-			param_eps.push_back(&ep);
-		} else {
-			static_eps.push_back(&ep);
-		}
-	}
-
-	if (!static_eps.empty()) {
-		out << "const std::unordered_map<std::pair<std::string_view, http::verb>, fnptr_t,\n";
-		out << "    ::siesta::beast::__detail::MapHash> STATIC_PATHS = {\n";
-		for (const auto* ep : static_eps) {
-			out << "\t{{\"" << escapeCppString(ep->path) << "\"sv, http::verb::" << ep->cpp_verb
-				<< "}, &Server::" << ep->function_name << "},\n";
-		}
-		out << "};\n\n";
-	}
-
-	out << "bool match_path(std::string_view pattern, std::string_view target) {\n";
-	out << "\twhile (!pattern.empty() && !target.empty()) {\n";
-	out << "\t\tif (pattern.front() == '/' && target.front() == '/') {\n";
-	out << "\t\t\tpattern.remove_prefix(1);\n";
-	out << "\t\t\ttarget.remove_prefix(1);\n";
-	out << "\t\t\tcontinue;\n";
-	out << "\t\t}\n";
-	out << "\t\tauto pp = pattern.find('/');\n";
-	out << "\t\tauto tp = target.find('/');\n";
-	out << "\t\tauto ps = pattern.substr(0, pp);\n";
-	out << "\t\tauto ts = target.substr(0, tp);\n";
-	out << "\t\tif (ps != \"{}\"sv && ps != ts) return false;\n";
-	out << "\t\tpattern = pp == std::string_view::npos ? \"\"sv : pattern.substr(pp);\n";
-	out << "\t\ttarget  = tp == std::string_view::npos ? \"\"sv : target.substr(tp);\n";
-	out << "\t}\n";
-	out << "\treturn pattern == target;\n";
-	out << "}\n";
+		std::string lines;
+		if (!ep.response_content_type.empty()) {
+			lines = "Content-Type: " + ep.response_content_type + "\r\n";
+		}
+		const auto content_type = lines.size();
+		lines += "Server: siesta\r\n";
+		out << "constexpr Server::HeaderBlock headers__" << ep.function_name << "{\"" << escapeCppString(lines)
+			<< "\"sv, " << content_type << ", static_cast<std::uint16_t>(Server::Route::" << ep.function_name << ")};\n";
+	}
 	out << "\n";
-
-	if (!param_eps.empty()) {
-		out << "const std::pair<std::string_view, std::pair<http::verb, fnptr_t>> PARAM_PATHS[] = {\n";
-		for (const auto* ep : param_eps) {
-			out << "\t{\"" << escapeCppString(ep->path_template) << "\"sv, {http::verb::" << ep->cpp_verb
-				<< ", &Server::" << ep->function_name << "}},\n";
+	if (options_.typed_handlers) {
+		out << "void bad_request(const Server::Session::Ptr& session, std::string_view reason) {\n";
+		out << "\tauto& resp = session->get_response();\n";
+		out << "\tresp.result(http::status::bad_request);\n";
+		out << "\tresp.set(http::field::content_type, \"application/json\");\n";
+		out << "\tresp.body() = std::string(\"{\\\"error\\\":\\\"\").append(reason).append(\"\\\"}\");\n";
+		out << "\tsession->write();\n";
+		out << "}\n";
+		out << "\n";
+		for (const auto& ep : endpoints) {
+			emitDecoder(out, ep, options_);
 		}
-		out << "};\n\n";
 	}
-
 	out << "} // anonymous namespace\n";
 	out << "\n";
 
-	out << "void Server::handle_request(const request req, Session::Ptr session) {\n";
-	out << "\tauto target = std::string_view(req.target());\n";
-	out << "\tif (auto q = target.find('?'); q != std::string_view::npos) target = target.substr(0, q);\n";
-	out << "\tconst auto method = req.method();\n";
+	const bool captures = std::any_of(endpoints.begin(), endpoints.end(), [](const Endpoint& ep) {
+		return !ep.path_captures.empty();
+	});
+	out << "Server::Route Server::route(std::string_view path, http::verb method, Captures&"
+		<< (captures ? " captures" : "") << ") noexcept {\n";
+	emitRouteNode(out, buildRouteTrie(endpoints), "path", 0, 0, 0);
+	out << "\treturn Route::none;\n";
+	out << "}\n";
 	out << "\n";
 
-	if (!static_eps.empty()) {
-		out << "\tif (auto it = STATIC_PATHS.find({target, method}); it != STATIC_PATHS.end()) {\n";
-		out << "\t\treturn (this->*(it->second))(req, std::move(session));\n";
-		out << "\t}\n";
-		out << "\n";
+	out << "std::span<const std::string_view> Server::endpoint_names() const noexcept {\n";
+	out << "\tstatic constexpr std::array<std::string_view, " << endpoints.size() + 1 << "> names{\n";
+	out << "\t\t\"other\"sv,\n";
+	for (const auto& ep : endpoints) {
+		out << "\t\t\"" << ep.function_name << "\"sv,\n";
 	}
+	out << "\t};\n";
+	out << "\treturn names;\n";
+	out << "}\n";
+	out << "\n";
 
-	if (!param_eps.empty()) {
-		out << "\tfor (const auto& [pattern, verb_fn] : PARAM_PATHS) {\n";
-		out << "\t\tif (match_path(pattern, target) && verb_fn.first == method) {\n";
-		out << "\t\t\treturn (this->*(verb_fn.second))(req, std::move(session));\n";
-		out << "\t\t}\n";
+	out << "Server::Resolution Server::resolve(const request_header& req, std::pmr::memory_resource&"
+		<< (captures ? " arena" : "") << ") const {\n";
+	out << "\tauto target = std::string_view(req.target());\n";
+	out << "\tif (auto q = target.find('?'); q != std::string_view::npos) target = target.substr(0, q);\n";
+	out << "\tCaptures captures;\n";
+	out << "\tconst auto found = route(target, req.method(), captures);\n";
+	out << "\tResolution resolution{static_cast<std::uint16_t>(found)};\n";
+	if (captures) {
+		out << "\tif (found != Route::none) {\n";
+		out << "\t\tresolution.captures = *std::pmr::polymorphic_allocator<>(&arena).new_object<Captures>(captures);\n";
 		out << "\t}\n";
-		out << "\n";
 	}
+	out << "\treturn resolution;\n";
+	out << "}\n";
+	out << "\n";
 
+	out << "void Server::handle_request(request& req, Session::Ptr session) {\n";
+	if (options_.typed_handlers) {
+		out << "\tconst auto target = std::string_view(req.target());\n";
+		out << "\tconst auto q = target.find('?');\n";
+		out << "\tconst auto query = q == std::string_view::npos ? std::string_view() : target.substr(q + 1);\n";
+	}
+	out << "\tconst auto& resolution = session->resolution();\n";
+	out << "\n";
+	out << "\tswitch (static_cast<Route>(resolution.route)) {\n";
+	for (const auto& ep : endpoints) {
+		out << "\tcase Route::" << ep.function_name << ":\n";
+		out << "\t\tsession->static_headers(headers__" << ep.function_name << ");\n";
+		out << "\t\treturn ";
+		std::vector<std::string> args;
+		for (std::size_t i = 0; i < ep.path_captures.size(); ++i) {
+			args.push_back("resolution.captures[" + std::to_string(i) + "]");
+		}
+		if (options_.typed_handlers) {
+			out << "decode__" << ep.function_name << "(*this, req, std::move(session), query";
+			for (const auto& arg : args) {
+				out << ", " << arg;
+			}
+			out << ");\n";
+		} else {
+			out << handlerCall(ep, options_, "", args) << ";\n";
+		}
+	}
+	out << "\tcase Route::none: break;\n";
+	out << "\t}\n";
+	out << "\n";
 	out << "\t// 404 Not Found\n";
 	out << "\tauto& resp = session->get_response();\n";
 	out << "\tresp.result(http::status::not_found);\n";
 	out << "\tsession->write();\n";
 	out << "}\n";
 	out << "\n";
+
+	if (hasBodyLimits(endpoints)) {
+		out << "std::uint64_t Server::body_limit(const request_header& req, const Resolution& resolution) const {\n";
+		out << "\tswitch (static_cast<Route>(resolution.route)) {\n";
+		for (const auto& ep : endpoints) {
+			if (ep.body_limit != 0) {
+				out << "\tcase Route::" << ep.function_name << ": return " << ep.body_limit << "u;\n";
+			}
+		}
+		out << "\tdefault: break;\n";
+		out << "\t}\n";
+		out << "\treturn ServerBase::body_limit(req, resolution);\n";
+		out << "}\n";
+		out << "\n";
+	}
+	if (hasJsonBodies(endpoints, options_)) {
+		out << "Server::BodyDecoder* Server::body_decoder(request_header& req, const Resolution& resolution,\n";
+		out << "                                         std::pmr::memory_resource& arena) const {\n";
+		out << "\tswitch (static_cast<Route>(resolution.route)) {\n";
+		for (const auto& ep : endpoints) {
+			if (decodesJsonBody(ep, options_)) {
+				out << "\tcase Route::" << ep.function_name << ": return ::siesta::beast::make_json_decoder<"
+					<< ep.body_type << ">(req, arena);\n";
+			}
+		}
+		out << "\tdefault: break;\n";
+		out << "\t}\n";
+		out << "\treturn nullptr;\n";
+		out << "}\n";
+		out << "\n";
+	}
 	out << "} // namespace " << ns_ << "\n";
 }
 
@@ -9,6 +9,7 @@
 #include <ostream>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
 namespace openapi::v3 {
@@ -26,6 +27,15 @@ private:
 	void emitServerCpp(std::ostream& out, const std::vector<Endpoint>& endpoints);
 
 	std::string ns_;
+	ServerOptions options_;
 };
 
+// (type, name) of each parameter an endpoint virtual takes after (request&, Session::Ptr): the router
+// captures, or with typed handlers the decoded body and parameters.
+std::vector<std::pair<std::string, std::string>> handlerParams(const Endpoint& ep, const ServerOptions& options);
+
+// Whether the endpoint's body is parsed into its type by a JSON decoder while it is read, leaving the
+// request body empty.
+bool decodesJsonBody(const Endpoint& ep, const ServerOptions& options);
+
 } // namespace codegen
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: Apache-2.0
 #include "Support/Filenames.hpp"
 #include "Backend/Beast/BeastServerPythonGen.hpp"
+#include "Backend/Beast/BeastServerGen.hpp"
 #include "Frontend/openapi.hpp"
 #include "Frontend/openapi3.hpp"
 #include <algorithm>
@@ -15,6 +16,7 @@ void BeastServerPythonGenerator::operator()(const CodegenArgs& args, const std::
 
 	module_name_ = args.module_name;
 	ns_ = args.ns;
+	options_ = args.server;
 	const auto& endpoints = *args.endpoints;
 
 	std::filesystem::create_directories(output_dir);
@@ -40,6 +42,8 @@ void BeastServerPythonGenerator::emitServerPy(std::ostream& out, const std::vect
 	out << "#include <boost/beast/core.hpp>\n";
 	out << "#include <boost/beast/http.hpp>\n";
 	out << "#include <boost/beast/http/field.hpp>\n";
+	out << "#include <boost/json.hpp>\n";
+	out << "#include <string_view>\n";
 	out << "#include <thread>\n";
 	out << "\n";
 	out << "#include \"server.hpp\"\n";
@@ -71,9 +75,8 @@ void BeastServerPythonGenerator::emitServerPy(std::ostream& out, const std::vect
 	out << "\treturn d;\n";
 	out << "}\n";
 	out << "\n";
-	out << "// Write a Python object as a JSON HTTP response\n";
-	out << "void write_json_response(const " << ns_ << "::Server::Session::Ptr& session, const nb::object& result) {\n";
-	out << "\tauto& resp = session->get_response();\n";
+	out << "// Fill in a JSON HTTP response from a Python object\n";
+	out << "void fill_json_response(" << ns_ << "::Server::response& resp, const nb::object& result) {\n";
 	out << "\ttry {\n";
 	out << "\t\tnb::object json_mod = nb::module_::import_(\"json\");\n";
 	out << "\t\tnb::str body = nb::cast<nb::str>(json_mod.attr(\"dumps\")(result));\n";
@@ -87,7 +90,6 @@ void BeastServerPythonGenerator::emitServerPy(std::ostream& out, const std::vect
 	out << "\t\tresp.set(http::field::content_type, \"application/json\");\n";
 	out << "\t\tresp.prepare_payload();\n";
 	out << "\t}\n";
-	out << "\tsession->write();\n";
 	out << "}\n";
 	out << "\n";
 	out << "} // anonymous namespace\n";
@@ -101,18 +103,20 @@ void BeastServerPythonGenerator::emitServerPy(std::ostream& out, const std::vect
 	out << "\tstd::thread _thread;\n";
 	out << "\n";
 	out << "\tPyServer() : " << ns_ << "::Server(ctx) {}\n";
-	out << "\t~PyServer() {\n";
-	out << "\t\tctx.stop();\n";
-	out << "\t\tif (_thread.joinable()) _thread.join();\n";
-	out << "\t}\n";
+	out << "\t~PyServer() { shutdown(); }\n";
 	out << "\n";
 	out << "\tvoid listen(std::string host, uint16_t port) {\n";
 	out << "\t\t" << ns_ << "::Server::start(boost::asio::ip::make_address(host), port);\n";
 	out << "\t\t_thread = std::thread([this] { ctx.run(); });\n";
 	out << "\t}\n";
+	out << "\tvoid listen_unix(std::string path) {\n";
+	out << "\t\t" << ns_ << "::Server::start(boost::asio::local::stream_protocol::endpoint(path));\n";
+	out << "\t\t_thread = std::thread([this] { ctx.run(); });\n";
+	out << "\t}\n";
 	out << "\tvoid shutdown() {\n";
 	out << "\t\tctx.stop();\n";
 	out << "\t\tif (_thread.joinable()) _thread.join();\n";
+	out << "\t\t" << ns_ << "::Server::stop();\n";
 	out << "\t}\n";
 	out << "\n";
 
@@ -120,28 +124,77 @@ void BeastServerPythonGenerator::emitServerPy(std::ostream& out, const std::vect
 		if (!ep.summary.empty()) {
 			write_multiline_comment(out, ep.summary, "\t");
 		}
-		out << "\tvoid " << ep.function_name << "(const request req, Session::Ptr session) override {\n";
+		// Untyped handlers receive the captures as arguments; typed ones get decoded values, which Python
+		// does not see, so the captures are taken from the session's resolution, or, in a coroutine,
+		// which has no session, by routing the target again.
+		const bool coro = options_.coroutines;
+		if (coro) {
+			out << "\t::boost::asio::awaitable<void> " << ep.function_name << "(request& req, response& resp";
+		} else {
+			out << "\tvoid " << ep.function_name << "(request& req, Session::Ptr session";
+		}
+		// A decoded JSON body has been consumed from the request, so Python gets it serialized again.
+		const bool json_body = decodesJsonBody(ep, options_);
+		const auto params = handlerParams(ep, options_);
+		for (std::size_t i = 0; i < params.size(); ++i) {
+			out << ", " << params[i].first;
+			if (!options_.typed_handlers) out << " path" << i;
+			else if (json_body && i == 0) out << " body";
+		}
+		out << ") override {\n";
+		if (!coro) {
+			out << "\t\tauto& resp = session->get_response();\n";
+		}
 		out << "\t\t{\n";
 		out << "\t\t\tnb::gil_scoped_acquire gil;\n";
 		out << "\t\t\tnb::detail::ticket nb_ticket(nb_trampoline, \"" << ep.function_name << "\", false);\n";
 		out << "\t\t\tif (nb_ticket.key.is_valid()) {\n";
 		out << "\t\t\t\ttry {\n";
-		out << "\t\t\t\t\tnb::object result = nb_trampoline.base().attr(nb_ticket.key)(request_to_dict(req));\n";
-		out << "\t\t\t\t\twrite_json_response(session, std::move(result));\n";
+		if (ep.path_captures.empty() && !json_body) {
+			out << "\t\t\t\t\tnb::object result = nb_trampoline.base().attr(nb_ticket.key)(request_to_dict(req));\n";
+		} else {
+			out << "\t\t\t\t\tnb::dict d = request_to_dict(req);\n";
+			if (json_body) {
+				out << "\t\t\t\t\tconst std::string text = boost::json::serialize(boost::json::value_from(body));\n";
+				out << "\t\t\t\t\td[\"body\"] = nb::str(text.c_str(), text.size());\n";
+			}
+		}
+		if (!ep.path_captures.empty()) {
+			if (options_.typed_handlers && !coro) {
+				for (std::size_t i = 0; i < ep.path_captures.size(); ++i) {
+					out << "\t\t\t\t\tconst std::string_view path" << i << " = session->resolution().captures[" << i
+						<< "];\n";
+				}
+			} else if (options_.typed_handlers) {
+				out << "\t\t\t\t\tCaptures captures;\n";
+				out << "\t\t\t\t\tconst auto target = std::string_view(req.target());\n";
+				out << "\t\t\t\t\troute(target.substr(0, target.find('?')), req.method(), captures);\n";
+				for (std::size_t i = 0; i < ep.path_captures.size(); ++i) {
+					out << "\t\t\t\t\tconst std::string_view path" << i << " = captures[" << i << "];\n";
+				}
+			}
+			out << "\t\t\t\t\tnb::dict path_params;\n";
+			for (std::size_t i = 0; i < ep.path_captures.size(); ++i) {
+				out << "\t\t\t\t\tpath_params[\"" << escapeCppString(ep.path_captures[i].wire_name)
+					<< "\"] = nb::str(path" << i << ".data(), path" << i << ".size());\n";
+			}
+			out << "\t\t\t\t\td[\"path_params\"] = std::move(path_params);\n";
+		}
+		if (!ep.path_captures.empty() || json_body) {
+			out << "\t\t\t\t\tnb::object result = nb_trampoline.base().attr(nb_ticket.key)(std::move(d));\n";
+		}
+		out << "\t\t\t\t\tfill_json_response(resp, std::move(result));\n";
 		out << "\t\t\t\t} catch (const std::exception& e) {\n";
-		out << "\t\t\t\t\tauto& resp = session->get_response();\n";
 		out << "\t\t\t\t\tresp.result(http::status::internal_server_error);\n";
 		out << "\t\t\t\t\tresp.body() = std::string(\"{\\\"error\\\":\\\"\") + e.what() + \"\\\"}\";\n";
 		out << "\t\t\t\t\tresp.set(http::field::content_type, \"application/json\");\n";
 		out << "\t\t\t\t\tresp.prepare_payload();\n";
-		out << "\t\t\t\t\tsession->write();\n";
 		out << "\t\t\t\t}\n";
-		out << "\t\t\t\treturn;\n";
+		out << (coro ? "\t\t\t\tco_return;\n" : "\t\t\t\tsession->write();\n\t\t\t\treturn;\n");
 		out << "\t\t\t}\n";
 		out << "\t\t}\n";
-		out << "\t\tauto& resp = session->get_response();\n";
 		out << "\t\tresp.result(http::status::not_implemented);\n";
-		out << "\t\tsession->write();\n";
+		out << (coro ? "\t\tco_return;\n" : "\t\tsession->write();\n");
 		out << "\t}\n";
 		out << "\n";
 	}
@@ -156,6 +209,9 @@ void BeastServerPythonGenerator::emitServerPy(std::ostream& out, const std::vect
 	out << "\t\t.def(\"listen\", [](" << ns_ << "::Server& s, std::string host, uint16_t port) {\n";
 	out << "\t\t\tstatic_cast<PyServer&>(s).listen(std::move(host), port);\n";
 	out << "\t\t}, nb::arg(\"host\") = std::string(\"localhost\"), nb::arg(\"port\") = 443)\n";
+	out << "\t\t.def(\"listen_unix\", [](" << ns_ << "::Server& s, std::string path) {\n";
+	out << "\t\t\tstatic_cast<PyServer&>(s).listen_unix(std::move(path));\n";
+	out << "\t\t}, nb::arg(\"path\"))\n";
 	out << "\t\t.def(\"shutdown\", [](" << ns_ << "::Server& s) { static_cast<PyServer&>(s).shutdown(); });\n";
 	out << "}\n";
 }
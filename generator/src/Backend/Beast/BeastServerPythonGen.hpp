@@ -28,6 +28,7 @@ private:
 
 	std::string module_name_;
 	std::string ns_;
+	ServerOptions options_;
 };
 
 } // namespace codegen
@@ -111,7 +111,7 @@ static schema::NormalizedAST buildAST(const openapi::v3::OpenAPIv3& spec) {
 	return ast;
 }
 
-bool generateFromOpenAPI(const fs::path& input_path, const fs::path& output_path, GenMode mode, bool python, const std::string& backend, const std::string& ns_override) {
+bool generateFromOpenAPI(const fs::path& input_path, const fs::path& output_path, GenMode mode, bool python, const std::string& backend, const std::string& ns_override, const ::codegen::ServerOptions& server) {
 	if (backend != "beast") {
 		std::cerr << "Unsupported backend '" << backend << "'. Only 'beast' is available.\n";
 		return false;
@@ -188,7 +188,7 @@ bool generateFromOpenAPI(const fs::path& input_path, const fs::path& output_path
 	std::string client_mod = module_name;
 	std::string server_mod = server_module;
 
-	::codegen::CodegenArgs args{ast, order, &spec, std::move(module_name), std::move(ns), &endpoints};
+	::codegen::CodegenArgs args{ast, order, &spec, std::move(module_name), std::move(ns), &endpoints, server};
 
 	::codegen::DefsGenerator{}(args, output_path);
 
@@ -202,7 +202,7 @@ bool generateFromOpenAPI(const fs::path& input_path, const fs::path& output_path
 		::codegen::BeastServerGenerator{}(args, output_path);
 
 	if (python && gen_server) {
-		::codegen::CodegenArgs server_args{ast, order, &spec, std::move(server_module), ns, &endpoints};
+		::codegen::CodegenArgs server_args{ast, order, &spec, std::move(server_module), ns, &endpoints, server};
 		::codegen::BeastServerPythonGenerator{}(server_args, output_path);
 	}
 
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: Apache-2.0
 #pragma once
 
+#include "IR/CodegenArgs.hpp"
 #include <filesystem>
 #include <string_view>
 
@@ -13,6 +14,7 @@ bool generateFromOpenAPI(const std::filesystem::path& input_path,
 						 GenMode mode = GenMode::both,
 						 bool python = true,
 						 const std::string& backend = "beast",
-						 const std::string& ns = "");
+						 const std::string& ns = "",
+						 const ::codegen::ServerOptions& server = {});
 
 } // namespace openapi::v3::codegen
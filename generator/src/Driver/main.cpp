@@ -22,6 +22,7 @@ int main(int argc, char* argv[]) try {
 	bool python = true;
 	bool no_python = false;
 	bool print_module_names = false;
+	::codegen::ServerOptions server_opts;
 
 	po::options_description desc;
 	auto opts = desc.add_options();
@@ -35,6 +36,10 @@ int main(int argc, char* argv[]) try {
 		 "C++ namespace for all generated code (default: derived from spec title).");
 	opts("no-python", po::bool_switch(&no_python),
 		 "Skip generating Python nanobind modules.");
+	opts("typed-handlers", po::bool_switch(&server_opts.typed_handlers),
+		 "Decode request parameters and bodies in the generated server and pass them to handlers as typed arguments.");
+	opts("coroutines", po::bool_switch(&server_opts.coroutines),
+		 "Generate server endpoints as boost::asio::awaitable coroutines whose response is written automatically.");
 	opts("print-module-names", po::bool_switch(&print_module_names),
 		 "Print client and server module names to stdout and exit.");
 	opts("help,h", "Print this help message.");
@@ -100,7 +105,7 @@ int main(int argc, char* argv[]) try {
 		std::cout << "Writing to " << output_dir.string() << '\n';
 	}
 
-	if (!openapi::v3::codegen::generateFromOpenAPI(input_json, output_dir, gen_mode, python, backend, ns)) {
+	if (!openapi::v3::codegen::generateFromOpenAPI(input_json, output_dir, gen_mode, python, backend, ns, server_opts)) {
 		return -1;
 	}
 
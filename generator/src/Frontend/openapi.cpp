@@ -219,6 +219,8 @@ ExternalDocumentation Operation::externalDocs() const {
 }
 std::string_view Operation::operationId() const { return _GetValueIfExist<std::string_view>("operationId"); }
 bool Operation::deprecated() const { return _GetValueIfExist<bool>("deprecated"); }
+std::string_view Operation::siestaExecution() const { return _GetValueIfExist<std::string_view>("x-siesta-execution"); }
+uint64_t Operation::siestaBodyLimit() const { return _GetValueIfExist<uint64_t>("x-siesta-body-limit"); }
 
 } // namespace common
 
@@ -260,6 +260,10 @@ public:
 	ExternalDocumentation externalDocs() const;
 	std::string_view operationId() const;
 	bool deprecated() const;
+	// siesta extension: "inline" (default) or "offload".
+	std::string_view siestaExecution() const;
+	// siesta extension: largest request body in bytes, 0 if unset.
+	uint64_t siestaBodyLimit() const;
 };
 
 template <typename OperationType>
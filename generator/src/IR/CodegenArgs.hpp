@@ -12,6 +12,16 @@ class OpenAPIv3;
 
 namespace codegen {
 
+// Server generator switches, set from the command line.
+struct ServerOptions {
+	// Decode path, query, header and body parameters in generated code and pass them to the
+	// endpoint virtuals as typed arguments.
+	bool typed_handlers = false;
+	// Endpoint virtuals are coroutines returning boost::asio::awaitable<void> that fill in the
+	// response; the runtime co_spawns them on the session executor and writes the response.
+	bool coroutines = false;
+};
+
 struct CodegenArgs {
 	const schema::NormalizedAST& ast;
 	const analysis::TopologicalOrder& order;
@@ -19,6 +29,7 @@ struct CodegenArgs {
 	std::string module_name = "siesta_bindings";
 	std::string ns = "api";
 	const std::vector<Endpoint>* endpoints = nullptr;
+	ServerOptions server = {};
 };
 
 class ICodeGenerator {
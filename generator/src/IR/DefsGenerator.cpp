@@ -205,7 +205,8 @@ void DefsGenerator::generateDefsHpp(std::ostream& out,
 	// Namespace
 	out << "namespace " << ns_ << " {\n";
 	out << "using siesta::url_encode;\n";
-	out << "using siesta::query_value;\n\n";
+	out << "using siesta::query_value;\n";
+	out << "using siesta::parse_value;\n\n";
 
 	// Forward declarations for all types
 	out << "// Forward declarations\n";
@@ -313,7 +314,7 @@ void DefsGenerator::generateDefsHpp(std::ostream& out,
 			*type);
 	}
 
-	// Enum query_value overloads — zero-overhead, in namespace api (ADL-visible)
+	// Enum query_value / parse_value overloads — zero-overhead, in namespace api (ADL-visible)
 	for (const auto& name : order.ordered_types) {
 		const auto* type = ast.getType(name);
 		if (!type) continue;
@@ -330,6 +331,13 @@ void DefsGenerator::generateDefsHpp(std::ostream& out,
 					out << "\t\tdefault: return \"\";\n";
 					out << "\t}\n";
 					out << "}\n";
+					out << "inline bool parse_value(std::string_view sv, " << name << "& val) {\n";
+					for (const auto& ev : t.values) {
+						out << "\tif (sv == \"" << escapeCppString(ev.value) << "\") { val = " << name
+						    << "::" << sanitize_enum_identifier(ev.name) << "; return true; }\n";
+					}
+					out << "\treturn false;\n";
+					out << "}\n";
 				} else if constexpr (std::is_same_v<T, schema::PrimitiveType>) {
 					if (!t.enum_values.empty()) {
 						out << "inline std::string query_value(" << name << " val) {\n";
@@ -341,6 +349,13 @@ void DefsGenerator::generateDefsHpp(std::ostream& out,
 						out << "\t\tdefault: return \"\";\n";
 						out << "\t}\n";
 						out << "}\n";
+						out << "inline bool parse_value(std::string_view sv, " << name << "& val) {\n";
+						for (const auto& ev : t.enum_values) {
+							out << "\tif (sv == \"" << escapeCppString(ev) << "\") { val = " << name << "::"
+							    << sanitize_enum_identifier(ev) << "; return true; }\n";
+						}
+						out << "\treturn false;\n";
+						out << "}\n";
 					}
 				}
 			},
@@ -72,11 +72,15 @@ std::vector<Endpoint> parseEndpoints(const openapi::v3::OpenAPIv3& spec) {
 		bool hasRequestBody = false;
 		std::string bodyType;
 		std::string bodyContentType;
+		std::string responseContentType;
+		std::string responseType;
 		struct {
 			bool is_ref = false;
 			std::string ref_comp;
 		} bodyRef;
 		bool hasOpSecurity = false;
+		bool offload = false;
+		uint64_t bodyLimit = 0;
 	};
 
 	std::vector<ColOp> collected;
@@ -129,7 +133,24 @@ std::vector<Endpoint> parseEndpoints(const openapi::v3::OpenAPIv3& spec) {
 				}
 			}
 
+			try {
+				for (const auto& [code, resp] : op_obj.responses()) {
+					if (code.empty() || code.front() != '2') continue;
+					for (const auto& [ct, mt] : resp.content()) {
+						co.responseContentType = std::string(ct);
+						auto schema = mt.schema();
+						if (schema && co.responseContentType.find("json") != std::string::npos) {
+							co.responseType = schema.IsRef() ? resolveRefName(schema.ref()) : schemaToCppType(schema);
+						}
+						break;
+					}
+					if (!co.responseContentType.empty()) break;
+				}
+			} catch (...) {}
+
 			try { co.hasOpSecurity = op_obj.HasKey("security"); } catch (...) {}
+			try { co.offload = op_obj.siestaExecution() == "offload"; } catch (...) {}
+			try { co.bodyLimit = op_obj.siestaBodyLimit(); } catch (...) {}
 
 			collected.push_back(std::move(co));
 		}
@@ -149,6 +170,10 @@ std::vector<Endpoint> parseEndpoints(const openapi::v3::OpenAPIv3& spec) {
 		if (!co.summary.empty()) ep.summary = co.summary;
 		if (!co.description.empty()) ep.description = co.description;
 		ep.function_name = generateFunctionName(method, co.path);
+		ep.offload = co.offload;
+		ep.body_limit = co.bodyLimit;
+		ep.response_content_type = co.responseContentType;
+		ep.response_type = co.responseType;
 
 		// Merge path-level + operation-level params
 		std::unordered_map<std::string, ClientParam> op_overrides;
@@ -224,6 +249,32 @@ std::vector<Endpoint> parseEndpoints(const openapi::v3::OpenAPIv3& spec) {
 		}
 		ep.path_template = tmpl;
 
+		// Router captures, in path order
+		for (std::string_view rest = co.path; !rest.empty();) {
+			const size_t cut = rest.find('/');
+			const std::string_view seg = rest.substr(0, cut);
+			rest = cut == std::string_view::npos ? std::string_view() : rest.substr(cut + 1);
+			if (seg.size() < 2 || seg.front() != '{' || seg.back() != '}') continue;
+
+			const std::string_view wire = seg.substr(1, seg.size() - 2);
+			auto it = std::find_if(ep.params.begin(), ep.params.end(), [&](const ClientParam& p) {
+				return p.location == "path" && p.wire_name == wire;
+			});
+			ClientParam cp;
+			if (it != ep.params.end()) {
+				cp = *it;
+			} else {
+				cp.wire_name = std::string(wire);
+				cp.name = sanitizeParamName(cp.wire_name);
+				cp.cpp_type = "std::string";
+				cp.required = true;
+				cp.location = "path";
+				cp.schema_type = "string";
+				cp.is_string_type = true;
+			}
+			ep.path_captures.push_back(std::move(cp));
+		}
+
 		endpoints.push_back(std::move(ep));
 	}
 
@@ -47,11 +47,21 @@ struct Endpoint {
 	std::string description;
 	std::string cpp_verb;
 	std::vector<ClientParam> params;
+	// Whole-segment path parameters ("/items/{id}") in path order, as captured by the server router.
+	std::vector<ClientParam> path_captures;
 	bool has_request_body = false;
 	std::string body_type;
 	std::string body_content_type;
+	// Media type of the first 2xx response with content; sent as a pre-rendered header by the server.
+	std::string response_content_type;
+	// C++ type of that response's JSON schema; empty unless the media type is JSON.
+	std::string response_type;
 	AuthType auth_type = AuthType::None;
 	std::string auth_header_name;
+	// Run on the server's offload pool instead of the io thread ("x-siesta-execution": "offload").
+	bool offload = false;
+	// Largest request body the server reads, in bytes ("x-siesta-body-limit"); 0 for the server default.
+	uint64_t body_limit = 0;
 };
 
 // --- Shared helpers used during endpoint parsing ---
@@ -84,7 +94,7 @@ inline std::string sanitizeParamName(std::string name) {
 		name = "param_" + name;
 	}
 	for (char& c : name) {
-		if (c == '[' || c == ']' || c == '(' || c == ')' || c == '{' || c == '}' || c == '.' || c == ',')
+		if (c == '[' || c == ']' || c == '(' || c == ')' || c == '{' || c == '}' || c == '.' || c == ',' || c == '-')
 			c = '_';
 	}
 	return name;
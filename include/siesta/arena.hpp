@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+namespace siesta {
+
+// Allocator that forwards to a std::pmr::memory_resource. Unlike std::pmr::polymorphic_allocator it is
+// copy-assignable, which beast requires of the allocators used by basic_fields and basic_string_body.
+// Containers swap or move-assign their storage only when both sides share a resource, so assignment
+// must propagate.
+template <typename T>
+class arena_allocator {
+public:
+	using value_type = T;
+	using propagate_on_container_copy_assignment = std::true_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+
+	arena_allocator() noexcept
+		: _resource(std::pmr::get_default_resource()) {}
+	arena_allocator(std::pmr::memory_resource* resource) noexcept
+		: _resource(resource) {}
+	template <typename U>
+	arena_allocator(const arena_allocator<U>& other) noexcept
+		: _resource(other.resource()) {}
+
+	T* allocate(std::size_t n) { return static_cast<T*>(_resource->allocate(n * sizeof(T), alignof(T))); }
+	void deallocate(T* p, std::size_t n) noexcept { _resource->deallocate(p, n * sizeof(T), alignof(T)); }
+
+	std::pmr::memory_resource* resource() const noexcept { return _resource; }
+
+	template <typename U>
+	bool operator==(const arena_allocator<U>& other) const noexcept {
+		return *_resource == *other.resource();
+	}
+
+private:
+	std::pmr::memory_resource* _resource;
+};
+
+} // namespace siesta
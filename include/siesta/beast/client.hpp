@@ -2,8 +2,13 @@
 #pragma once
 
 #include <boost/asio/compose.hpp>
+#include <boost/asio/generic/stream_protocol.hpp>
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <boost/asio/ssl/host_name_verification.hpp>
+#include <boost/asio/ssl/stream.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
@@ -14,7 +19,11 @@
 #include <memory>
 
 #include <siesta/beast/error.hpp>
+#include <siesta/beast/socket_options.hpp>
+#include <siesta/compress.hpp>
 #include <siesta/format.hpp>
+#include <siesta/json_body.hpp>
+#include <siesta/trace.hpp>
 
 namespace siesta::beast {
 
@@ -22,19 +31,37 @@ class ClientBase : public std::enable_shared_from_this<ClientBase> {
 public:
 	using request_type = ::boost::beast::http::request<::boost::beast::http::string_body>;
 	using response_type = ::boost::beast::http::response<::boost::beast::http::string_body>;
-	using protocol = ::boost::asio::ip::tcp;
+	// TCP and UNIX domain socket endpoints both convert to protocol::endpoint.
+	using protocol = ::boost::asio::generic::stream_protocol;
 	using outcome_type = ::boost::outcome_v2::std_outcome<response_type>;
+	template <typename T>
+	using json_outcome_type = ::boost::outcome_v2::std_outcome<T>;
 	using error_type = ::boost::system::error_code;
 
 	struct Config {
 		std::chrono::milliseconds connect_timeout;
 		std::chrono::milliseconds write_timeout;
 		std::chrono::milliseconds read_timeout;
+		// Offers gzip and deflate in Accept-Encoding and decodes compressed responses before
+		// completing. Typed JSON reads parse the body as it arrives and never offer them.
+		bool accept_compressed;
+		// Largest body a compressed response may decode to. Larger ones complete with
+		// errc::bad_message rather than growing without bound.
+		std::size_t max_decoded_size;
+		// Options for the connection, set before it is made. The listener-only fields are unused,
+		// except that a positive fast_open connects with TCP Fast Open.
+		SocketOptions socket;
+		// Sampled tracing, off while 0. One call in trace_sample per thread records its write and
+		// read as spans into the thread's trace ring; see <siesta/trace.hpp>.
+		uint32_t trace_sample;
 
 		Config()
 			: connect_timeout(1000)
 			, write_timeout(1000)
-			, read_timeout(1000) {}
+			, read_timeout(1000)
+			, accept_compressed(true)
+			, max_decoded_size(8 * 1024 * 1024)
+			, trace_sample(0) {}
 	};
 
 	ClientBase(::boost::asio::io_context&, Config = Config());
@@ -43,12 +70,23 @@ public:
 	virtual ~ClientBase() { stop(); }
 
 	void start(const ::boost::asio::ip::address&, uint16_t);
-	void start(const protocol::endpoint&);
+	void start(const ::boost::asio::ip::tcp::endpoint&);
+	// Connects to a server on a UNIX domain socket; a path converts implicitly.
+	void start(const ::boost::asio::local::stream_protocol::endpoint&);
+
+	// Speaks TLS from the next start() on, over a context shared with other clients (see
+	// make_client_tls_context() in <siesta/beast/tls.hpp>) that must outlive this one. `server_name`
+	// is sent as SNI and checked against the certificate when the context verifies peers. Each
+	// connection offers the session of the one before it, so a reconnect resumes with an abbreviated
+	// handshake while the server still accepts the session.
+	void use_tls(::boost::asio::ssl::context&, std::string server_name);
+	// Whether the current TLS connection resumed an earlier session.
+	bool tls_resumed() const;
 
 	::boost::asio::io_context& context() { return _ctx; }
 
 	void stop() {
-		_resolver.cancel();
+		keep_tls_session();
 		_stream.close();
 	}
 
@@ -56,9 +94,16 @@ protected:
 	Config _conf;
 	::boost::asio::io_context& _ctx;
 	::boost::asio::strand<::boost::asio::io_context::executor_type> _strand;
-	protocol::resolver _resolver;
 	::boost::beast::flat_buffer _buffer;
-	::boost::beast::tcp_stream _stream;
+	::boost::beast::basic_stream<protocol> _stream;
+	using tls_stream = ::boost::asio::ssl::stream<::boost::beast::basic_stream<protocol>&>;
+	struct SessionFree {
+		void operator()(SSL_SESSION* session) const noexcept { SSL_SESSION_free(session); }
+	};
+	::boost::asio::ssl::context* _tls_context{nullptr};
+	std::string _server_name;
+	std::unique_ptr<tls_stream> _tls; // per connection, while TLS is on
+	std::unique_ptr<SSL_SESSION, SessionFree> _tls_session; // offered by the next connection
 	request_type _request;
 	response_type _response;
 
@@ -66,8 +111,58 @@ protected:
 
 	std::array<unsigned char, 1024 + 256 + 128> _json_buffer;
 
-	void on_resolve(const error_type&, protocol::resolver::results_type);
-	void on_connect(const error_type&, protocol::resolver::endpoint_type);
+	// Phase timestamps of a sampled call; the rest carry id 0 and take no timestamps.
+	struct CallTrace {
+		uint64_t id{0};
+		::siesta::trace_clock::time_point start;
+		::siesta::trace_clock::time_point sent;
+
+		explicit CallTrace(uint32_t sample)
+			: id(::siesta::trace_sample(sample) ? ::siesta::next_trace_id() : 0) {}
+		void mark(::siesta::trace_clock::time_point& at) {
+			if (id != 0) {
+				at = ::siesta::trace_clock::now();
+			}
+		}
+	};
+	// Records the spans of a sampled call that has just completed, or failed.
+	void finish_trace(const CallTrace&) const;
+
+	void connect(const protocol::endpoint&);
+	void on_connect(const error_type&);
+	void on_handshake(const error_type&);
+	void keep_tls_session() noexcept;
+
+	// Runs `op` with the stream requests are written to and responses read from.
+	template <typename Op>
+	void with_stream(Op&& op) {
+		if (_tls) {
+			op(*_tls);
+		} else {
+			op(_stream);
+		}
+	}
+
+	// Replaces a gzip or deflate body with its decoded bytes. False if it does not decode.
+	bool decode_response(response_type& resp) const {
+		namespace http = ::boost::beast::http;
+		const auto it = resp.find(http::field::content_encoding);
+		if (it == resp.end()) {
+			return true;
+		}
+		const auto coding = ::siesta::parse_coding({it->value().data(), it->value().size()});
+		if (coding == ::siesta::coding::identity) {
+			return true;
+		}
+		std::string decoded;
+		if (!::siesta::decompress(coding, resp.body(), decoded, _conf.max_decoded_size)) {
+			return false;
+		}
+		resp.body() = std::move(decoded);
+		resp.erase(http::field::content_encoding);
+		resp.content_length(resp.body().size());
+		return true;
+	}
 
 	template <typename T>
 		requires ::boost::json::has_value_to<T>::value
@@ -81,34 +176,45 @@ protected:
 	auto async_submit_request(request_type req, CompletionToken&& token) {
 		_request = std::move(req);
 		_request.set(::boost::beast::http::field::host, _host_value);
+		if (_conf.accept_compressed && _request.count(::boost::beast::http::field::accept_encoding) == 0) {
+			_request.set(::boost::beast::http::field::accept_encoding, "gzip, deflate");
+		}
 		return ::boost::asio::async_compose<CompletionToken, void(outcome_type)>(
-			[this, lifetime = shared_from_this(), state = 0](
+			[this, lifetime = shared_from_this(), state = 0, trace = CallTrace(_conf.trace_sample)](
 				auto& self, ::boost::system::error_code error = {}, std::size_t bytes = 0) mutable -> void {
 				namespace http = ::boost::beast::http;
 				if (error) {
+					finish_trace(trace);
 					self.complete(error);
 					return;
 				}
 				switch (state) {
 				case 0: { // send
+					trace.mark(trace.start);
 					state = 1;
 					_stream.expires_after(_conf.write_timeout);
-					http::async_write(_stream, _request, std::move(self));
+					with_stream([&](auto& stream) { http::async_write(stream, _request, std::move(self)); });
 					return;
 				}
 				case 1: { // recv
+					trace.mark(trace.sent);
 					_response = {};
 					state = 2;
 					_stream.expires_after(_conf.read_timeout);
-					http::async_read(_stream, _buffer, _response, std::move(self));
+					with_stream([&](auto& stream) { http::async_read(stream, _buffer, _response, std::move(self)); });
 					return;
 				}
 				default:
 					break;
 				}
+				finish_trace(trace);
 				const auto http_status_code = this->_response.result();
 				if (http::to_status_class(http_status_code) == http::status_class::successful) {
-					self.complete(std::move(this->_response));
+					if (decode_response(this->_response)) {
+						self.complete(std::move(this->_response));
+					} else {
+						self.complete(std::make_error_code(std::errc::bad_message));
+					}
 				} else {
 					self.complete(std::make_error_code(http_status_code));
 				}
@@ -116,6 +222,62 @@ protected:
 			},
 			token);
 	}
+
+	// Like async_submit_request, but a successful response's body is parsed into T while it is read.
+	// The header is read first; other statuses complete with their status code as before, after their
+	// body has been read and discarded.
+	template <typename T, ::boost::asio::completion_token_for<void(json_outcome_type<T>)> CompletionToken>
+	auto async_submit_json(request_type req, CompletionToken&& token) {
+		namespace http = ::boost::beast::http;
+		using typed_parser = http::response_parser<::siesta::typed_json_body<T>>;
+		using discard_parser = http::response_parser<http::string_body>;
+		_request = std::move(req);
+		_request.set(http::field::host, _host_value);
+		_request.erase(http::field::accept_encoding);
+		return ::boost::asio::async_compose<CompletionToken, void(json_outcome_type<T>)>(
+			[this, lifetime = shared_from_this(), state = 0, parser = std::make_unique<typed_parser>(),
+		     discard = std::unique_ptr<discard_parser>(), trace = CallTrace(_conf.trace_sample)](
+				auto& self, ::boost::system::error_code error = {}, std::size_t bytes = 0) mutable -> void {
+				if (error) {
+					finish_trace(trace);
+					self.complete(error);
+					return;
+				}
+				switch (state) {
+				case 0: // send
+					trace.mark(trace.start);
+					state = 1;
+					_stream.expires_after(_conf.write_timeout);
+					with_stream([&](auto& stream) { http::async_write(stream, _request, std::move(self)); });
+					return;
+				case 1: // recv header
+					trace.mark(trace.sent);
+					state = 2;
+					_stream.expires_after(_conf.read_timeout);
+					with_stream([&](auto& stream) { http::async_read_header(stream, _buffer, *parser, std::move(self)); });
+					return;
+				case 2: // recv body
+					if (http::to_status_class(parser->get().result()) == http::status_class::successful) {
+						state = 3;
+						with_stream([&](auto& stream) { http::async_read(stream, _buffer, *parser, std::move(self)); });
+					} else {
+						state = 4;
+						discard = std::make_unique<discard_parser>(std::move(*parser));
+						with_stream([&](auto& stream) { http::async_read(stream, _buffer, *discard, std::move(self)); });
+					}
+					return;
+				case 3:
+					finish_trace(trace);
+					self.complete(std::move(parser->get().body()));
+					return;
+				default:
+					finish_trace(trace);
+					self.complete(std::make_error_code(discard->get().result()));
+					return;
+				}
+			},
+			token);
+	}
 };
 
 /// Returns true if this error is likely transient (caller may retry).
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include <memory_resource>
+#include <optional>
+#include <siesta/beast/server.hpp>
+#include <siesta/json_body.hpp>
+#include <string_view>
+
+namespace siesta::beast {
+
+// Parses a JSON request body into T as it is read, through typed_json_body<T>'s reader, so the body
+// is never held as text. ok() is false once the body turned out not to be valid JSON for T, or had
+// bytes other than whitespace after the value.
+template <typename T>
+class json_decoder final : public ServerBase::BodyDecoder {
+public:
+	explicit json_decoder(ServerBase::request_header& header)
+		: _reader(header, _value) {}
+
+	void init(std::optional<uint64_t> length) override {
+		_reader.init(length ? ::boost::optional<uint64_t>(*length) : ::boost::none, _ec);
+	}
+
+	void put(std::string_view bytes) override {
+		if (!_ec) {
+			_reader.put(::boost::asio::const_buffer(bytes.data(), bytes.size()), _ec);
+		}
+	}
+
+	void finish() override {
+		if (!_ec) {
+			_reader.finish(_ec);
+		}
+		_finished = true;
+	}
+
+	bool ok() const noexcept { return _finished && !_ec; }
+	T& value() noexcept { return _value; }
+
+private:
+	T _value{};
+	typename typed_json_body<T>::reader _reader;
+	ServerBase::ec_t _ec;
+	bool _finished{false};
+};
+
+// Allocates a json_decoder<T> from an exchange's arena, for ServerBase::body_decoder() overrides.
+template <typename T>
+ServerBase::BodyDecoder* make_json_decoder(ServerBase::request_header& header, std::pmr::memory_resource& arena) {
+	return std::pmr::polymorphic_allocator<>(&arena).new_object<json_decoder<T>>(header);
+}
+
+} // namespace siesta::beast
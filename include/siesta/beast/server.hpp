@@ -2,77 +2,616 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/basic_socket_acceptor.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/generic/stream_protocol.hpp>
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/ip/address.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
 #include <boost/asio/post.hpp>
+#include <boost/asio/signal_set.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <boost/asio/ssl/stream.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/asio/system_timer.hpp>
+#include <boost/asio/thread_pool.hpp>
 #include <boost/beast/core.hpp>
-#include <boost/beast/core/tcp_stream.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/beast/http/read.hpp>
+#include <chrono>
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <siesta/arena.hpp>
+#include <siesta/beast/socket_options.hpp>
+#include <siesta/metrics.hpp>
+#include <siesta/timer_wheel.hpp>
+#include <siesta/trace.hpp>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(SIESTA_IO_URING)
+#include <boost/asio/buffer_registration.hpp>
+#endif
 
 namespace siesta::beast {
 
 class ServerBase {
 public:
-	using request = ::boost::beast::http::request<::boost::beast::http::string_body>;
-	using response = ::boost::beast::http::response<::boost::beast::http::string_body>;
-	using protocol = ::boost::asio::ip::tcp;
+	// Requests and responses allocate their fields and bodies from a per-request arena.
+	using allocator_type = ::siesta::arena_allocator<char>;
+	using fields = ::boost::beast::http::basic_fields<allocator_type>;
+	using body = ::boost::beast::http::basic_string_body<char, std::char_traits<char>, allocator_type>;
+	using request = ::boost::beast::http::request<body, fields>;
+	using response = ::boost::beast::http::response<body, fields>;
+	// A request whose header has been parsed but whose body has not been read yet.
+	using request_header = ::boost::beast::http::request_header<fields>;
+	// Sessions and listeners are protocol-agnostic stream sockets, so the same server listens on TCP
+	// and on UNIX domain sockets. Both endpoint types convert to protocol::endpoint.
+	using protocol = ::boost::asio::generic::stream_protocol;
 	using ec_t = ::boost::system::error_code;
 
 	struct Config {
+		// Deadline for the TLS handshake of a new connection; only used once use_tls() was called.
+		std::chrono::milliseconds handshake_timeout{std::chrono::seconds{10}};
 		std::chrono::milliseconds read_timeout{std::chrono::hours{1}};
 		std::chrono::milliseconds write_timeout{std::chrono::seconds{30}};
+		// Resolution of the read and write deadlines. They fire up to one tick late.
+		std::chrono::milliseconds timer_tick{std::chrono::milliseconds{100}};
+		// Number of io threads. With more than one, the server runs threads - 1 additional
+		// io_contexts, each on its own thread pinned to a core, and every io_context accepts on
+		// its own SO_REUSEPORT listener. The caller's io_context is the first of them.
+		// 0 means one io thread per hardware thread.
+		std::size_t threads{1};
+		// Most requests a session holds at once, including the one being answered. A keep-alive
+		// session keeps reading and parsing pipelined requests until this many are queued.
+		std::size_t pipeline_limit{16};
+		// Size of the inline arena each request/response pair allocates from. Larger messages
+		// spill over to the heap.
+		std::size_t arena_size{4096};
+		// Worker threads for endpoints marked "x-siesta-execution: offload". The pool is started
+		// the first time such an endpoint is hit.
+		std::size_t offload_threads{2};
+		// Most offloaded requests queued or running at once. Past this, offloaded endpoints are
+		// answered with 503 instead of queueing more work.
+		std::size_t offload_queue{64};
+		// Admission control. Each limit is off while 0.
+		// Most open connections. Connections past it are closed as soon as they are accepted.
+		std::size_t max_connections{0};
+		// Most requests being handled at once across all sessions. Requests past it are answered
+		// with a canned 503.
+		std::size_t max_in_flight{0};
+		// CoDel-style queue-time control. A request's queue time runs from when it is parsed to when
+		// it is handed to its handler. Once the shortest queue time seen during a whole
+		// queue_interval exceeds queue_target, requests that queued longer than twice the target
+		// are answered with a canned 503 until an interval passes under the target.
+		std::chrono::milliseconds queue_target{0};
+		std::chrono::milliseconds queue_interval{100};
+		// Idle keep-alive sessions hand their read buffer and spare exchanges back to their shard,
+		// which keeps up to pool_size of each for the next session that has bytes to read. Read
+		// buffers that grew past pooled_buffer_size are freed instead.
+		std::size_t pool_size{256};
+		std::size_t pooled_buffer_size{16384};
+		// Largest request body read, unless the endpoint sets its own ("x-siesta-body-limit"). Bodies
+		// declared larger are answered with 413 as soon as the header is parsed, without reading them.
+		std::uint64_t body_limit{1024 * 1024};
+		// Responses written with write() whose body is at least compress_min_size bytes are sent
+		// gzip- or deflate-encoded when the request's Accept-Encoding allows it, at zlib level
+		// compress_level. Off while 0. Each io thread reuses one zlib stream per coding.
+		std::size_t compress_min_size{0};
+		int compress_level{6};
+		// io_uring builds only (SIESTA_IO_URING): each io thread registers this many read buffers of
+		// registered_buffer_size bytes with its ring. An idle session then waits for its next request
+		// with one fixed-buffer read into one of them, rather than a readiness poll and a read.
+		// Sessions that find none free poll as before. Off while 0.
+		std::size_t registered_buffers{256};
+		std::size_t registered_buffer_size{4096};
+		// Options for the listeners and every accepted connection, backlog included.
+		SocketOptions socket;
+		// Per-endpoint latency and size histograms and response counters, recorded by every io
+		// thread into its own block. Off by default. While on, GET requests for metrics_path are
+		// answered by the server itself in the Prometheus text format, ahead of the router, so pick a
+		// path the API does not use.
+		bool metrics{false};
+		std::string metrics_path{"/metrics"};
+		// Sampled tracing, off while 0. One request in trace_sample per io thread has its phases
+		// (accept, header, body, queue, handler, write) recorded as spans into the thread's trace
+		// ring; see <siesta/trace.hpp>. While on, GET requests for trace_path are answered with the
+		// rings as Chrome trace JSON, and a trace_signal other than 0 writes them to trace_file.
+		std::uint32_t trace_sample{0};
+		std::string trace_path{"/debug/trace"};
+		int trace_signal{0};
+		std::string trace_file{"siesta-trace.json"};
+	};
+
+	// Header lines an endpoint sends with every response, rendered by the generator. `lines` is a
+	// run of complete "Name: value\r\n" lines; the first `content_type` bytes of it are the
+	// Content-Type line, which is left out when the handler sets its own. `endpoint` indexes
+	// endpoint_names(), under which the response is counted.
+	struct HeaderBlock {
+		std::string_view lines;
+		std::size_t content_type{0};
+		std::uint16_t endpoint{0};
+	};
+
+	// Takes a request body as it is read, in place of collecting it into the request as text.
+	// Installed by body_decoder() once the header is parsed. A decoder keeps its own errors for the
+	// handler to find, so a body it cannot decode is still read to its end.
+	struct BodyDecoder {
+		virtual ~BodyDecoder() = default;
+		// Called before the first byte with the Content-Length, when given.
+		virtual void init(std::optional<uint64_t>) = 0;
+		virtual void put(std::string_view) = 0;
+		virtual void finish() = 0;
 	};
 
-	class Session : public std::enable_shared_from_this<Session> {
+	// Where the router sends a request, worked out by resolve() once its header is parsed and kept
+	// with the exchange for body_limit(), body_decoder() and the handler. `route` numbers the
+	// server's endpoints, 0 for none; `captures` are views into the request target, allocated from
+	// the exchange's arena.
+	struct Resolution {
+		std::uint16_t route{0};
+		std::span<const std::string_view> captures;
+	};
+
+	// Admission control counters. The shed_* counts only ever grow.
+	struct AdmissionStats {
+		std::size_t connections;   // open now
+		std::size_t in_flight;     // being handled now; only counted while max_in_flight is set
+		uint64_t shed_connections; // closed at accept time over max_connections
+		uint64_t shed_in_flight;   // answered 503 over max_in_flight
+		uint64_t shed_queue;       // answered 503 by queue-time control
+		uint64_t shed_offload;     // answered 503 with the offload queue full
+	};
+
+protected:
+	struct Shard;
+
+public:
+	// Sessions are hooked into their shard's timer wheel while a read or write deadline is armed.
+	// They are reference counted intrusively and recycled through their shard's free list once the
+	// last Ptr to them goes away.
+	class Session : protected ::siesta::timer_wheel_hook {
 	public:
-		using Ptr = std::shared_ptr<Session>;
-		Session(ServerBase&, protocol::socket, Config, uint64_t);
-		~Session() noexcept;
+		// Owning handle on a session. On an owned shard, whose sessions only its one io thread
+		// touches, copying and dropping a handle is a plain increment and decrement; sessions on the
+		// shared shard, and sessions that have been share()d, count atomically.
+		class Ptr {
+		public:
+			Ptr() noexcept = default;
+			explicit Ptr(Session* session) noexcept
+				: _session(session) {
+				if (_session != nullptr) {
+					_session->add_ref();
+				}
+			}
+			Ptr(const Ptr& other) noexcept
+				: Ptr(other._session) {}
+			Ptr(Ptr&& other) noexcept
+				: _session(std::exchange(other._session, nullptr)) {}
+			Ptr& operator=(Ptr other) noexcept {
+				std::swap(_session, other._session);
+				return *this;
+			}
+			~Ptr() {
+				if (_session != nullptr) {
+					_session->release();
+				}
+			}
+
+			Session* get() const noexcept { return _session; }
+			Session* operator->() const noexcept { return _session; }
+			Session& operator*() const noexcept { return *_session; }
+			explicit operator bool() const noexcept { return _session != nullptr; }
+
+		private:
+			friend Session;
+			friend ServerBase;
+			struct adopt_t {};
+			Ptr(Session* session, adopt_t) noexcept
+				: _session(session) {}
+
+			Session* _session{nullptr};
+		};
+
+		Session(ServerBase&, Shard&);
+		~Session() noexcept = default;
 
 		void run();
 		uint64_t id() const { return _id; }
+		// Makes the reference count atomic for the rest of this connection. Call it before handing
+		// a Ptr to another thread; offload() does so itself.
+		void share() noexcept { _confined = false; }
 
-		response& get_response() noexcept { return _response; }
+		request& get_request() noexcept { return _current->req; }
+		response& get_response() noexcept { return _current->res; }
+		// The decoder the current request's body went to, or null if it is in get_request().body().
+		BodyDecoder* decoder() const noexcept { return _current->decoder; }
+		// What resolve() made of the current request.
+		const Resolution& resolution() const noexcept { return _current->resolution; }
+		// Writes the current response. May be called from any thread; the write itself is started
+		// on the session's executor.
 		void write();
+		// Produces a streamed response body. Called on the session's executor until it returns
+		// false, each time appending the next piece of the body to the string it is given.
+		using ChunkSource = std::function<bool(std::string&)>;
+		// Writes the current response's status and fields, then the body produced by the source with
+		// chunked transfer encoding, one piece at a time. HTTP/1.0 clients get the pieces gathered
+		// into an ordinary body. May be called from any thread, like write().
+		void write_chunked(ChunkSource);
+		// Writes the current response's status and fields, then the file at `path` as its body, with
+		// sendfile(2) on Linux. Returns false without writing anything if the file cannot be opened.
+		// May be called from any thread, like write().
+		bool write_file(const std::string& path);
+		// Sends the endpoint's pre-rendered header lines with the current response. The block must
+		// outlive the exchange; generated servers pass static ones.
+		void static_headers(const HeaderBlock& block) noexcept { _current->headers = &block; }
+		// Runs a coroutine handler on the session's executor, then writes the response it filled in.
+		// An exception escaping the handler is answered with 500.
+		void spawn(::boost::asio::awaitable<void>);
 
 	protected:
 		friend ServerBase;
 
+		// Body type requests are parsed with: the text, unless a decoder takes the bytes instead.
+		struct incoming_body {
+			struct value_type {
+				explicit value_type(const allocator_type& alloc)
+					: text(alloc) {}
+
+				body::value_type text;
+				BodyDecoder* decoder{nullptr};
+			};
+
+			class reader {
+			public:
+				template <bool isRequest, class Fields>
+				reader(::boost::beast::http::header<isRequest, Fields>&, value_type& body)
+					: _body(body) {}
+
+				void init(const ::boost::optional<uint64_t>& length, ec_t& ec) {
+					ec = {};
+					if (_body.decoder != nullptr) {
+						_body.decoder->init(length ? std::optional<uint64_t>(*length) : std::nullopt);
+					} else if (length) {
+						_body.text.reserve(static_cast<std::size_t>(*length));
+					}
+				}
+
+				template <typename ConstBufferSequence>
+				std::size_t put(const ConstBufferSequence& buffers, ec_t& ec) {
+					ec = {};
+					std::size_t size = 0;
+					const auto end = ::boost::asio::buffer_sequence_end(buffers);
+					for (auto it = ::boost::asio::buffer_sequence_begin(buffers); it != end; ++it) {
+						const ::boost::asio::const_buffer buffer = *it;
+						const std::string_view bytes(static_cast<const char*>(buffer.data()), buffer.size());
+						if (_body.decoder != nullptr) {
+							_body.decoder->put(bytes);
+						} else {
+							_body.text.append(bytes);
+						}
+						size += bytes.size();
+					}
+					return size;
+				}
+
+				void finish(ec_t& ec) {
+					ec = {};
+					if (_body.decoder != nullptr) {
+						_body.decoder->finish();
+					}
+				}
+
+			private:
+				value_type& _body;
+			};
+		};
+
+		// A request, its response and the monotonic arena both allocate from. The arena is
+		// rewound when the exchange is recycled, so a steady keep-alive connection parses and
+		// answers small requests without touching the heap.
+		struct Exchange {
+			std::unique_ptr<std::byte[]> storage;
+			std::pmr::monotonic_buffer_resource arena;
+			request req;
+			response res;
+			// Only stamped while `timed`; parsed also while queue_target is set.
+			std::chrono::steady_clock::time_point read;       // the header started to be read
+			std::chrono::steady_clock::time_point header;     // the header was parsed
+			std::chrono::steady_clock::time_point parsed;     // the whole request was parsed
+			std::chrono::steady_clock::time_point dispatched; // handed to the handler
+			std::chrono::steady_clock::time_point writing;    // the response started to be written
+			uint64_t trace_id{0}; // sampled for tracing while not 0
+			bool timed{false};    // metrics are on or the exchange is traced
+			const HeaderBlock* headers{nullptr};
+			// Set by resolve() once the header is parsed. The target its captures view moves into
+			// req along with the rest of the header.
+			Resolution resolution;
+			// Allocated from the arena by body_decoder(), and given the body in place of req.
+			BodyDecoder* decoder{nullptr};
+			// Reads the request header first, then the body; moved into req once complete.
+			std::optional<::boost::beast::http::request_parser<incoming_body, allocator_type>> parser;
+			bool rejected{false}; // the body is over its limit; answered with 413
+			// Status line and dynamic header lines of the response, rendered by do_write().
+			std::basic_string<char, std::char_traits<char>, allocator_type> head;
+			// The compressed body, when encode_body() picked a coding.
+			std::basic_string<char, std::char_traits<char>, allocator_type> packed;
+
+			explicit Exchange(std::size_t);
+			void reset();
+		};
+		using ExchangePtr = std::unique_ptr<Exchange>;
+
+		// A streamed response body, allocated only while one is being written.
+		struct BodySource {
+			ChunkSource chunks;
+			std::string chunk;
+			std::array<char, 24> size_line;
+			// The pieces of the chunk being written. A write keeps a view of them until it completes.
+			std::array<::boost::asio::const_buffer, 4> pieces;
+			int fd{-1};
+			uint64_t offset{0};
+			uint64_t remaining{0};
+			uint64_t sent{0}; // body bytes written so far
+			bool last{false};
+
+			~BodySource();
+		};
+		using BufferPtr = std::unique_ptr<::boost::beast::flat_buffer>;
+		using tls_stream = ::boost::asio::ssl::stream<protocol::socket&>;
+
 		ServerBase& _parent;
-		::boost::beast::tcp_stream _stream;
-		::boost::beast::flat_buffer _buffer;
-		request _request;
-		response _response;
-		Config _config;
-		uint64_t _id;
+		Shard& _shard;
+		protocol::socket _stream;
+		// TLS over _stream, while the server serves TLS. Created per connection from the server's
+		// shared context.
+		std::unique_ptr<tls_stream> _tls;
+		// Only held while there are bytes to parse or requests in flight; see release_idle().
+		BufferPtr _buffer;
+		ExchangePtr _incoming;
+		std::unique_ptr<BodySource> _body;
+		// Parsed requests, oldest first. The front one is being handled; responses are written
+		// strictly in this order.
+		std::deque<ExchangePtr> _pipeline;
+		std::vector<ExchangePtr> _spare;
+		// The exchange being handled. Kept apart from _pipeline so that handlers running on the
+		// offload pool never look into the deque while reads append to it.
+		Exchange* _current{nullptr};
+		const Config& _config;
+		std::atomic<uint32_t> _refs{0};
+		bool _confined{false}; // only the owning shard's thread holds Ptrs, so _refs need no atomic RMW
+		uint64_t _id{0};
+		bool _reading{false};
+		bool _waiting{false}; // _reading, but still waiting for the socket to become readable
+		bool _writing{false};
+		bool _eof{false};
+		bool _timed_out{false};
+		bool _stopping{false}; // closed by ServerBase::stop(); handled like a timeout, without the warnings
+		uint32_t _deadline_epoch{0}; // bumped whenever the deadline is armed or disarmed
+		bool _shed{false}; // the current request was answered with a canned response
+		bool _fresh{false}; // no request read yet; a sampled first one gets an accept span
+		// Neighbours in the shard's list of open sessions, which stop() closes.
+		Session* _prev_open{nullptr};
+		Session* _next_open{nullptr};
+		std::chrono::steady_clock::time_point _opened; // only stamped while tracing
+#if defined(SIESTA_IO_URING)
+		int _landing{-1}; // registered buffer of the shard an idle read is landing in
+#endif
+
+		// Runs `op` with the stream requests are read from and responses written to.
+		template <typename Op>
+		void with_stream(Op&& op) {
+			if (_tls) {
+				op(*_tls);
+			} else {
+				op(_stream);
+			}
+		}
+
+		void add_ref() noexcept;
+		void release() noexcept;
+		bool try_add_ref() noexcept;
+		void open(protocol::socket, uint64_t);
+		void retire() noexcept;
+		void handshake();
+		void on_handshake(ec_t);
 
+		ExchangePtr acquire();
+		void recycle(ExchangePtr);
+		void release_idle();
 		void do_read();
+		void on_readable(ec_t);
+#if defined(SIESTA_IO_URING)
+		void on_landed(ec_t, std::size_t);
+#endif
+		void start_read();
+		void on_header(ec_t);
+		void read_body();
 		void on_read(ec_t, std::size_t);
+		void dispatch();
+		void shed();
+		void write_canned(std::string_view);
+		void write_report(std::string_view, const std::string&);
+		void record_metrics(std::size_t);
+		void record_trace();
+		void do_write();
+		::boost::asio::const_buffer encode_body();
+		void do_write_chunked();
+		void next_chunk(ec_t, std::size_t);
+		void do_write_file();
+		void next_file_piece(ec_t, std::size_t);
+#if defined(__linux__)
+		void send_file_piece();
+#endif
+		// Content-Length when given; a chunked body adds its Transfer-Encoding line itself.
+		void render_head(std::optional<uint64_t>);
+		std::array<::boost::asio::const_buffer, 3> head_buffers() const;
+		void abort_write(ec_t);
 		void on_write(ec_t, std::size_t);
+		void on_deadline(uint32_t);
 		void do_close();
 	};
 
 	ServerBase(boost::asio::io_context&);
 	ServerBase(boost::asio::io_context&, Config);
+	virtual ~ServerBase() noexcept;
 
 	void start(const ::boost::asio::ip::address, uint16_t);
-	void start(const protocol::endpoint&);
+	void start(const ::boost::asio::ip::tcp::endpoint&);
+	// Listens on a UNIX domain socket; a path converts implicitly. A stale socket file left at the
+	// path is replaced, and the file is removed again by stop().
+	void start(const ::boost::asio::local::stream_protocol::endpoint&);
 
-	virtual void handle_request(const request, Session::Ptr) = 0;
+	// Serves TLS on connections accepted from now on. The context is shared by every session and must
+	// outlive the server; make_server_tls_context() in <siesta/beast/tls.hpp> builds one with session
+	// resumption enabled. Call it before start().
+	void use_tls(::boost::asio::ssl::context& context) noexcept { _tls_context = &context; }
+
+	// Joins the io threads owned by the server, closes every listener and every open connection, and
+	// runs what the closed connections left queued, so that no handler refers to the server once it
+	// is gone. Call it once the caller's io_context has stopped, or from the thread running it; in the
+	// latter case the caller's io_context runs those handlers itself, and must do so before the
+	// server is destroyed.
+	void stop();
+
+	// The request is owned by the session and stays valid until its response has been written,
+	// so handlers take it by reference and may move out of it.
+	virtual void handle_request(request&, Session::Ptr) = 0;
+
+	// Resolves a request whose header has just been parsed, allocating what it keeps from `arena`.
+	// Called before body_limit() and body_decoder(), which are given the outcome, as the handler is
+	// through Session::resolution(); generated servers route the request here, once.
+	virtual Resolution resolve(const request_header&, std::pmr::memory_resource&) const { return {}; }
+	// Largest body accepted for a request whose header has just been parsed. Generated servers
+	// override it for endpoints with their own limit; the default is Config::body_limit.
+	virtual std::uint64_t body_limit(const request_header&, const Resolution&) const { return _conf.body_limit; }
+	// Decoder for the body of a request whose header has just been parsed, allocated from `arena`,
+	// or null to collect the body as text. Generated typed servers decode JSON bodies with it while
+	// they are read; see <siesta/beast/json_decoder.hpp>.
+	virtual BodyDecoder* body_decoder(request_header&, const Resolution&, std::pmr::memory_resource&) const {
+		return nullptr;
+	}
+
+	// Runs a handler on the offload pool. The handler fills in the response and calls
+	// session->write() as usual. When Config::offload_queue requests are already pending the
+	// handler is dropped and the request is answered with 503; an exception escaping the handler
+	// is answered with 500.
+	void offload(Session::Ptr, std::function<void()>);
+	// Coroutine flavour: the coroutine runs on the offload pool and the response is written once
+	// it completes.
+	void offload(Session::Ptr, ::boost::asio::awaitable<void>);
+
+	AdmissionStats admission_stats() const noexcept;
+
+	// Names of the endpoints metrics are kept for, indexed by HeaderBlock::endpoint. Index 0 counts
+	// responses not attributed to an endpoint. Generated servers name the rest after their handlers.
+	virtual std::span<const std::string_view> endpoint_names() const noexcept;
+	// Appends the metrics of every endpoint and the admission counters in the Prometheus text format.
+	// Nothing while Config::metrics is off.
+	void render_metrics(std::string&) const;
 
 protected:
+	// An io_context and the listener that feeds it. Sessions stay on the shard that accepted them.
+	struct Shard {
+		boost::asio::io_context& ctx;
+		::boost::asio::basic_socket_acceptor<protocol> acceptor;
+		bool shared; // true for the caller's io_context, which may be run from several threads
+		// Read and write deadlines of the shard's sessions, in ticks of Config::timer_tick. One
+		// ticker per shard advances the wheel, and only while it has entries. On the shared shard
+		// the wheel is guarded by the mutex and expired sessions are closed on their own strands.
+		::siesta::timer_wheel wheel;
+		boost::asio::steady_timer ticker;
+		std::chrono::milliseconds tick;
+		std::mutex wheel_mutex;
+		bool ticking{false};
+		std::vector<std::pair<Session::Ptr, uint32_t>> expired;
+		// Storage handed back by idle sessions. Guarded by pool_mutex on the shared shard.
+		std::mutex pool_mutex;
+		std::vector<Session::BufferPtr> buffers;
+		std::vector<Session::ExchangePtr> exchanges;
+		// Retired sessions, reused for the next accepted connection.
+		std::vector<std::unique_ptr<Session>> sessions;
+		// Sessions between open() and retire(), linked through their _prev_open and _next_open.
+		// Guarded by pool_mutex on the shared shard.
+		Session* open{nullptr};
+		std::size_t pool_size;
+		std::size_t pooled_buffer_size;
+#if defined(SIESTA_IO_URING)
+		// Buffers registered with the shard's ring for idle reads, and the indices of those not in
+		// use. Guarded by pool_mutex on the shared shard.
+		std::vector<char> landing_storage;
+		std::optional<::boost::asio::buffer_registration<std::vector<::boost::asio::mutable_buffer>>> landing;
+		std::vector<int> free_landing;
+#endif
+
+		Shard(boost::asio::io_context&, bool, const Config&);
+		void arm(Session&, std::chrono::milliseconds);
+		void disarm(Session&);
+		void on_tick(const ec_t&);
+		uint64_t now() const;
+		Session::BufferPtr take_buffer();
+		Session::ExchangePtr take_exchange();
+		void give(Session::BufferPtr);
+		void give(Session::ExchangePtr);
+		Session::Ptr take_session(ServerBase&);
+		void give(Session*);
+		void enter(Session&);
+		void leave(Session&);
+#if defined(SIESTA_IO_URING)
+		void register_landing(const Config&);
+		int take_landing();
+		void give_landing(int);
+#endif
+	};
+
 	Config _conf;
 	boost::asio::io_context* _ctx{nullptr};
-	protocol::acceptor _acceptor;
+	std::vector<std::unique_ptr<boost::asio::io_context>> _pool;
+	std::vector<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> _work;
+	std::vector<std::unique_ptr<Shard>> _shards;
+	std::vector<std::thread> _threads;
 	std::atomic<uint64_t> _client_id{0};
+	std::unique_ptr<boost::asio::thread_pool> _offload;
+	std::once_flag _offload_once;
+	std::atomic<std::size_t> _offload_pending{0};
+	std::atomic<std::size_t> _connections{0};
+	std::atomic<std::size_t> _in_flight{0};
+	std::atomic<uint64_t> _shed_connections{0};
+	std::atomic<uint64_t> _shed_in_flight{0};
+	std::atomic<uint64_t> _shed_queue{0};
+	std::atomic<uint64_t> _shed_offload{0};
+	// CoDel state, in steady_clock ticks, shared by all shards.
+	std::atomic<int64_t> _codel_interval_end{0};
+	std::atomic<int64_t> _codel_min_delay{0};
+	std::atomic<bool> _codel_overloaded{false};
+	std::unique_ptr<::siesta::request_metrics> _metrics; // created by serve() while Config::metrics is on
+	std::unique_ptr<::boost::asio::signal_set> _trace_signals; // while Config::trace_signal is set
+	::boost::asio::ssl::context* _tls_context{nullptr};
+	bool _inet{true};        // listening on TCP rather than a UNIX domain socket
+	std::string _local_path; // the UNIX domain socket file to remove on stop()
 
-	void on_accept(const ec_t&, protocol::socket);
+	void serve(const protocol::endpoint&);
+	void wait_trace_signal();
+	bool listen(Shard&, const protocol::endpoint&);
+	void do_accept(Shard&);
+	void on_accept(Shard&, const ec_t&, protocol::socket);
+	boost::asio::thread_pool& offload_pool();
+	bool admit_offload(Session&);
+	bool admit(const Session::Exchange&);
+	bool over_queue_target(std::chrono::steady_clock::duration);
 };
 
 namespace __detail {
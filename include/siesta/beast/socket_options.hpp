@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+/// Socket tuning shared by ServerBase::Config and ClientBase::Config. Each option that is off or 0
+/// keeps the operating system's setting and costs no system call; of the defaults, only no_delay is
+/// on, and it is set on every TCP connection. Options the kernel refuses are skipped quietly; TCP
+/// options are skipped on UNIX domain sockets.
+
+namespace siesta::beast {
+
+struct SocketOptions {
+	// TCP_NODELAY. Without it, a small write waits for the ACK of the previous one, which the peer
+	// may hold back for its delayed-ACK timeout (up to 40 ms on Linux).
+	bool no_delay{true};
+	// TCP_QUICKACK (Linux). ACK at once instead of delaying. The kernel drops back to delayed ACKs
+	// on its own, so the server re-arms it after every request it reads.
+	bool quick_ack{false};
+	// SO_RCVBUF and SO_SNDBUF in bytes; 0 keeps the kernel's autotuning. Set on the listener, so that
+	// accepted sockets inherit them before the handshake fixes the window scale.
+	int receive_buffer{0};
+	int send_buffer{0};
+	// SO_BUSY_POLL (Linux): microseconds a blocking read spins on the device queue before sleeping.
+	int busy_poll{0};
+
+	// Listener only.
+	// Pending connections the kernel queues before accept().
+	int backlog{64};
+	// TCP_DEFER_ACCEPT (Linux): seconds to hold a connection back from accept() until its first
+	// bytes arrive. Clients that connect and then wait on the server are not suited to it.
+	int defer_accept{0};
+	// TCP_FASTOPEN: length of the queue of connections carrying data in their SYN; 0 or less leaves
+	// it off. On a client, any positive value connects with TCP_FASTOPEN_CONNECT (Linux).
+	int fast_open{0};
+};
+
+// Applies the listener's options to a socket that is open but not yet bound.
+void apply_listener_options(int fd, const SocketOptions&, bool inet) noexcept;
+// Applies the per-connection options to an accepted socket. Buffer sizes are inherited from the
+// listener and not set again.
+void apply_accepted_options(int fd, const SocketOptions&, bool inet) noexcept;
+// Applies the options to a client socket that is open but not yet connected.
+void apply_connect_options(int fd, const SocketOptions&, bool inet) noexcept;
+// Re-arms TCP_QUICKACK when it is enabled.
+void rearm_quick_ack(int fd, const SocketOptions&, bool inet) noexcept;
+
+} // namespace siesta::beast
@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+/// TLS contexts for ServerBase::use_tls() and ClientBase::use_tls(). A context is built once and
+/// shared by every connection; connections only create their own SSL object.
+
+#include <array>
+#include <boost/asio/ssl/context.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace siesta::beast {
+
+// TLS 1.2 and later, with session tickets and a server-side session cache, so that returning
+// clients resume with an abbreviated handshake. Both live in the context: without use_ticket_keys(),
+// sessions are lost when it is destroyed. Load the certificate and key afterwards.
+void configure_server_tls(::boost::asio::ssl::context&);
+
+// A session ticket key: a 16-byte name, a 32-byte HMAC-SHA256 secret and a 32-byte AES-256 key.
+using tls_ticket_key = std::array<unsigned char, 80>;
+
+// Makes the server encrypt tickets with keys.front() and accept tickets under any of `keys`, in
+// place of the keys the context generated for itself, which die with it. Servers given the same
+// keys resume each other's sessions, and a restarted server resumes those of its predecessor. To
+// rotate, put a new key in front and keep the old one until its tickets expire. Does nothing when
+// `keys` is empty.
+void use_ticket_keys(::boost::asio::ssl::context&, std::vector<tls_ticket_key> keys);
+
+// Reads a key from a file of exactly 80 bytes, e.g. made by `openssl rand 80 > ticket.key`. Empty
+// if the file cannot be read or has another size.
+std::optional<tls_ticket_key> load_ticket_key(const std::string& file);
+
+// A configured server context with the PEM certificate chain and private key loaded from files.
+::boost::asio::ssl::context make_server_tls_context(const std::string& cert_chain_file, const std::string& key_file);
+
+// TLS 1.2 and later, verifying the server against the system's default trust store. Sessions
+// offered back by ClientBase are resumed when the server still accepts them.
+::boost::asio::ssl::context make_client_tls_context();
+
+} // namespace siesta::beast
@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+/// gzip and deflate content codings, as negotiated through Accept-Encoding and Content-Encoding.
+/// Each thread keeps one zlib stream per coding and resets it between messages, so compressing
+/// a response allocates nothing once the thread has warmed up.
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace siesta {
+
+enum class coding { identity, gzip, deflate };
+
+// The coding to answer with, given a request's Accept-Encoding value. gzip is preferred over
+// deflate at equal quality; anything refused with q=0 or not listed is not used.
+coding negotiate_coding(std::string_view accept_encoding) noexcept;
+
+// The coding named by a Content-Encoding value, or identity for anything else.
+coding parse_coding(std::string_view content_encoding) noexcept;
+
+std::string_view coding_name(coding) noexcept;
+
+// Largest output compress() can produce for `size` input bytes.
+std::size_t compress_bound(coding, std::size_t size) noexcept;
+
+// Compresses `in` into `out`, which must have room for compress_bound() bytes, at the given zlib
+// level. Returns the compressed size, or 0 if zlib failed.
+std::size_t compress(coding, int level, std::string_view in, char* out) noexcept;
+
+// Decompresses `in` and appends the result to `out`. Returns false on a corrupt or truncated
+// stream, or when the result would exceed `limit` bytes.
+bool decompress(coding, std::string_view in, std::string& out, std::size_t limit = std::string::npos);
+
+} // namespace siesta
@@ -1,8 +1,10 @@
 // SPDX-License-Identifier: Apache-2.0
 #pragma once
-/// Shared encoding utilities for generated siesta clients.
+/// Shared encoding utilities for generated siesta clients and servers.
 /// Included by each generated openapi_defs.hpp — not duplicated per project.
 
+#include <charconv>
+#include <concepts>
 #include <cstdint>
 #include <string>
 #include <string_view>
@@ -43,4 +45,73 @@ inline std::string query_value(const T&) {
 	return {};
 }
 
+// --- Decoding, used by typed server handlers ---
+
+// Inverse of url_encode. Malformed escapes are copied through verbatim. Query values are form
+// encoded, where '+' stands for a space; pass plus_as_space for those.
+inline std::string url_decode(std::string_view sv, bool plus_as_space = false) {
+	auto hex = [](char c) -> int {
+		if (c >= '0' && c <= '9') return c - '0';
+		if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+		if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+		return -1;
+	};
+	std::string result;
+	result.reserve(sv.size());
+	for (size_t i = 0; i < sv.size(); ++i) {
+		if (sv[i] == '%' && i + 2 < sv.size()) {
+			const int hi = hex(sv[i + 1]), lo = hex(sv[i + 2]);
+			if (hi >= 0 && lo >= 0) {
+				result += static_cast<char>((hi << 4) | lo);
+				i += 2;
+				continue;
+			}
+		}
+		result += plus_as_space && sv[i] == '+' ? ' ' : sv[i];
+	}
+	return result;
+}
+
+// Calls f(key, value) for each `key=value` pair of a query string, left to right, without decoding.
+// Stops and returns false as soon as f returns false.
+template <typename F>
+inline bool for_each_query_param(std::string_view query, F&& f) {
+	while (!query.empty()) {
+		const auto amp = query.find('&');
+		const auto pair = query.substr(0, amp);
+		query = amp == std::string_view::npos ? std::string_view() : query.substr(amp + 1);
+		if (pair.empty()) continue;
+		const auto eq = pair.find('=');
+		const auto value = eq == std::string_view::npos ? std::string_view() : pair.substr(eq + 1);
+		if (!f(pair.substr(0, eq), value)) return false;
+	}
+	return true;
+}
+
+// Inverse of query_value: parses a parameter already url_decode()d. Returns false on malformed input.
+inline bool parse_value(std::string_view sv, std::string& v) {
+	v = sv;
+	return true;
+}
+
+inline bool parse_value(std::string_view sv, bool& v) {
+	if (sv == "true") { v = true; return true; }
+	if (sv == "false") { v = false; return true; }
+	return false;
+}
+
+template <typename T>
+	requires(std::integral<T> || std::floating_point<T>)
+inline bool parse_value(std::string_view sv, T& v) {
+	const auto [end, ec] = std::from_chars(sv.data(), sv.data() + sv.size(), v);
+	return ec == std::errc() && end == sv.data() + sv.size();
+}
+
+// Catch-all, as for query_value. Enum types get their own parse_value overloads (emitted per schema).
+template <typename T>
+inline bool parse_value(std::string_view, T&) {
+	static_assert(sizeof(T) == 0, "parse_value: no overload for this type.");
+	return false;
+}
+
 } // namespace siesta
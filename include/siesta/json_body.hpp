@@ -59,8 +59,9 @@ struct json_body {
 		template <class ConstBufferSequence>
 		std::size_t put(ConstBufferSequence const& buffers, boost::system::error_code& ec) {
 			ec = {};
-			// The parser just uses the `ec` to indicate errors, so we don't need to do anything.
-			return parser.write_some(static_cast<const char*>(buffers.data()), buffers.size(), ec);
+			// The parser just uses the `ec` to indicate errors, so we don't need to do anything. Unlike
+			// write_some, write fails with extra_data on bytes left over after the value.
+			return parser.write(static_cast<const char*>(buffers.data()), buffers.size(), ec);
 		}
 
 		void finish(boost::system::error_code& ec) {
@@ -78,4 +79,76 @@ struct json_body {
 	};
 };
 
+// A body holding a generated defs type, JSON on the wire. The reader feeds the bytes to a stream
+// parser as they arrive, over a resource sized by Content-Length, and converts to T once the body
+// is complete, so the body is never buffered as text first. The writer converts T to a value once
+// and serializes it straight into the send buffer.
+template <typename T>
+	requires ::boost::json::has_value_to<T>::value && ::boost::json::has_value_from<T>::value
+struct typed_json_body {
+	using value_type = T;
+
+	struct writer {
+		using const_buffers_type = boost::asio::const_buffer;
+		template <bool isRequest, class Fields>
+		writer(boost::beast::http::header<isRequest, Fields> const&, value_type const& body)
+			: value(::boost::json::value_from(body, &resource)) {
+			serializer.reset(&value);
+		}
+
+		void init(boost::system::error_code& ec) { ec = {}; }
+
+		boost::optional<std::pair<const_buffers_type, bool>> get(boost::system::error_code& ec) {
+			ec = {};
+			const auto len = serializer.read(buffer, sizeof(buffer));
+			return std::make_pair(boost::asio::const_buffer(len.data(), len.size()), !serializer.done());
+		}
+
+	private:
+		::boost::json::monotonic_resource resource;
+		::boost::json::value value;
+		::boost::json::serializer serializer;
+		char buffer[32768];
+	};
+
+	struct reader {
+		template <bool isRequest, class Fields>
+		reader(boost::beast::http::header<isRequest, Fields>&, value_type& body)
+			: body(body) {}
+
+		void init(boost::optional<std::uint64_t> const& content_length, boost::system::error_code& ec) {
+			// Shared, because values inside T may keep referring to the resource they were parsed into.
+			if (content_length) {
+				parser.reset(::boost::json::make_shared_resource<::boost::json::monotonic_resource>(*content_length));
+			}
+			ec = {};
+		}
+
+		template <class ConstBufferSequence>
+		std::size_t put(ConstBufferSequence const& buffers, boost::system::error_code& ec) {
+			ec = {};
+			// Bytes after the value are extra_data, not a second document.
+			return parser.write(static_cast<const char*>(buffers.data()), buffers.size(), ec);
+		}
+
+		void finish(boost::system::error_code& ec) {
+			ec = {};
+			if (!parser.done()) {
+				ec = ::boost::json::error::incomplete;
+				return;
+			}
+			auto result = ::boost::json::try_value_to<T>(parser.release());
+			if (result) {
+				body = std::move(*result);
+			} else {
+				ec = result.error();
+			}
+		}
+
+	private:
+		::boost::json::stream_parser parser;
+		value_type& body;
+	};
+};
+
 } // namespace siesta
\ No newline at end of file
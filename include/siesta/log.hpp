@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+/// Asynchronous logging. A thread logging a record copies it into a ring buffer of its own, taking no
+/// lock and making no system call; a background thread drains the rings of all threads and hands the
+/// formatted lines to the sink in batches. Records that find their ring full, that exceed their
+/// facility's rate limit, or whose thread cannot get a ring allocated, are dropped and counted instead.
+///
+/// Lines are logfmt-style: time, level and facility, then the fields present, e.g.
+///   2026-01-02T03:04:05.678901Z warning on_read session=42 error="system:104 Connection reset by peer"
+
+#include <boost/system/error_code.hpp>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string_view>
+
+namespace siesta {
+
+enum class log_level : uint8_t { debug, info, warning, error, off };
+
+// Stands for "no session" where a session id is expected.
+inline constexpr uint64_t log_no_session = std::numeric_limits<uint64_t>::max();
+
+struct log_config {
+	// Records below this level are discarded where they are logged.
+	log_level level{log_level::info};
+	// Records per second each thread may log per facility. The rest are dropped, and their number
+	// is logged ahead of the facility's first record in a later second. Unlimited while 0.
+	uint32_t rate_limit{100};
+	// Receives batches of complete lines from the drain thread. Writes to stderr while empty.
+	std::function<void(std::string_view)> sink;
+	// How long the drain thread sleeps between rounds.
+	std::chrono::milliseconds drain_interval{50};
+};
+
+// Replaces the configuration. Records already logged are drained under the new one.
+void configure_log(log_config);
+
+bool log_enabled(log_level) noexcept;
+
+// `facility` must be a string literal, or otherwise outlive the process's logging. `text` is copied
+// and cut short past 95 bytes.
+void log_message(log_level, const char* facility, std::string_view text, uint64_t session = log_no_session) noexcept;
+// Logs an error code; its message is looked up by the drain thread.
+void log_error(log_level, const char* facility, const ::boost::system::error_code&,
+               uint64_t session = log_no_session) noexcept;
+
+// Drains every ring and returns once the sink has the lines. Records logged concurrently may be
+// left for the next round.
+void flush_log();
+
+} // namespace siesta
@@ -0,0 +1,140 @@
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+/// Per-endpoint request metrics. Every thread records into a block of its own with plain loads and
+/// stores, so recording takes no lock and no locked instruction; a scrape sums the blocks of all
+/// threads. Rendered in the Prometheus text format by render_prometheus().
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace siesta {
+
+// Log-linear histogram in the style of HdrHistogram: every power of two is split into four
+// sub-buckets, so a recorded value is known to within 25% across the whole uint64_t range.
+//
+// Single writer. Only the owning thread records, so counts are bumped with a relaxed load and
+// store rather than a locked add; other threads may read them at any time.
+class histogram {
+public:
+	static constexpr unsigned sub_bits = 2;
+	static constexpr std::size_t sub_buckets = std::size_t(1) << sub_bits;
+	static constexpr std::size_t buckets = (64 - sub_bits + 1) * sub_buckets;
+
+	static constexpr std::size_t bucket(uint64_t value) noexcept {
+		if (value < sub_buckets) {
+			return value;
+		}
+		const unsigned exponent = std::bit_width(value) - 1;
+		return ((exponent - sub_bits + 1) << sub_bits) + ((value >> (exponent - sub_bits)) & (sub_buckets - 1));
+	}
+
+	// Smallest value counted in bucket `index`.
+	static constexpr uint64_t lower_bound(std::size_t index) noexcept {
+		if (index < sub_buckets) {
+			return index;
+		}
+		const unsigned exponent = index / sub_buckets + sub_bits - 1;
+		return (sub_buckets + index % sub_buckets) << (exponent - sub_bits);
+	}
+
+	void record(uint64_t value) noexcept {
+		bump(_counts[bucket(value)], 1);
+		bump(_sum, value);
+	}
+
+	uint64_t count(std::size_t index) const noexcept { return _counts[index].load(std::memory_order_relaxed); }
+	uint64_t sum() const noexcept { return _sum.load(std::memory_order_relaxed); }
+
+	static void bump(std::atomic<uint64_t>& counter, uint64_t by) noexcept {
+		counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+	}
+
+private:
+	std::array<std::atomic<uint64_t>, buckets> _counts{};
+	std::atomic<uint64_t> _sum{0};
+};
+
+// Histograms of several threads summed at one point in time.
+struct histogram_snapshot {
+	std::array<uint64_t, histogram::buckets> counts{};
+	uint64_t sum{0};
+	uint64_t count{0};
+
+	void add(const histogram&) noexcept;
+	// Lower bound of the bucket holding the q-quantile, for 0 <= q <= 1. 0 while empty.
+	uint64_t quantile(double q) const noexcept;
+	// Values recorded below `limit`, which must be a power of two.
+	uint64_t count_below(uint64_t limit) const noexcept;
+};
+
+// What a server records per endpoint. Endpoint 0 stands for requests answered before an endpoint
+// was picked: unrouted paths, shed requests and oversized bodies.
+class request_metrics {
+public:
+	struct sample {
+		std::size_t endpoint;
+		uint64_t read_ns;    // from the first read of the request until it was parsed
+		uint64_t handler_ns; // from dispatch until the handler wrote the response
+		uint64_t write_ns;   // writing the response
+		uint64_t bytes;      // response bytes written
+		unsigned status;
+	};
+
+	struct endpoint_snapshot {
+		histogram_snapshot read_ns;
+		histogram_snapshot handler_ns;
+		histogram_snapshot write_ns;
+		histogram_snapshot bytes;
+		std::array<uint64_t, 5> responses{}; // 1xx to 5xx
+	};
+
+	struct snapshot {
+		std::vector<endpoint_snapshot> endpoints;
+		uint64_t connections{0};
+		uint64_t timeouts{0};
+	};
+
+	explicit request_metrics(std::size_t endpoints);
+	request_metrics(const request_metrics&) = delete;
+	request_metrics& operator=(const request_metrics&) = delete;
+	~request_metrics();
+
+	// Record into the calling thread's block, which is created the first time a thread records.
+	void record(const sample&);
+	void count_connection();
+	void count_timeout();
+
+	// Sums the blocks of all threads. Counts recorded concurrently may or may not be included.
+	snapshot collect() const;
+
+private:
+	struct endpoint_stats;
+	struct thread_block;
+
+	thread_block& local();
+
+	const uint64_t _id; // tells instances apart in the per-thread cache, unlike their addresses
+	const std::size_t _endpoints;
+	mutable std::mutex _mutex; // guards _blocks; taken once per thread, and by collect()
+	std::vector<std::unique_ptr<thread_block>> _blocks;
+};
+
+// Appends the snapshot to `out` in the Prometheus text exposition format (version 0.0.4). `names`
+// labels the endpoints and must be as long as snapshot.endpoints. Endpoints nothing was recorded for
+// are left out.
+void render_prometheus(std::string& out, const request_metrics::snapshot&, std::span<const std::string_view> names);
+
+// Appends a single unlabelled sample with its HELP and TYPE lines.
+void render_prometheus_value(std::string& out, std::string_view name, std::string_view type, std::string_view help,
+                             uint64_t value);
+
+} // namespace siesta
@@ -0,0 +1,175 @@
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace siesta {
+
+class timer_wheel;
+
+// Intrusive node for timer_wheel. The scheduled object holds one (usually as a base class), so arming,
+// re-arming and cancelling a deadline only relinks pointers and never allocates.
+class timer_wheel_hook {
+public:
+	timer_wheel_hook() noexcept = default;
+	timer_wheel_hook(const timer_wheel_hook&) = delete;
+	timer_wheel_hook& operator=(const timer_wheel_hook&) = delete;
+	~timer_wheel_hook() noexcept { unlink(); }
+
+	bool linked() const noexcept { return _next != nullptr; }
+	uint64_t expiry() const noexcept { return _expiry; }
+
+	void unlink() noexcept {
+		if (_next != nullptr) {
+			_prev->_next = _next;
+			_next->_prev = _prev;
+			_prev = _next = nullptr;
+		}
+	}
+
+private:
+	friend timer_wheel;
+
+	timer_wheel_hook* _prev{nullptr};
+	timer_wheel_hook* _next{nullptr};
+	uint64_t _expiry{0};
+
+	void link_before(timer_wheel_hook& pos) noexcept {
+		_prev = pos._prev;
+		_next = &pos;
+		_prev->_next = this;
+		pos._prev = this;
+	}
+};
+
+// Hierarchical timer wheel over abstract ticks. Level 0 has one slot per tick; each further level has
+// one slot per full turn of the level below, and its slots are cascaded down as time reaches them.
+// Scheduling and cancelling are O(1); advancing costs one slot visit per tick plus the entries that
+// expire or cascade. Deadlines beyond the top level are parked in its farthest slot and re-placed
+// on every cascade until they come into range.
+//
+// Not thread-safe. Callers that share a wheel between threads must lock around it.
+class timer_wheel {
+public:
+	static constexpr unsigned slot_bits = 6;
+	static constexpr std::size_t slots = std::size_t(1) << slot_bits;
+	static constexpr std::size_t levels = 4;
+
+	timer_wheel() noexcept {
+		for (auto& level : _wheel) {
+			for (auto& slot : level) {
+				slot._prev = slot._next = &slot;
+			}
+		}
+	}
+	timer_wheel(const timer_wheel&) = delete;
+	timer_wheel& operator=(const timer_wheel&) = delete;
+	~timer_wheel() noexcept {
+		for (auto& level : _wheel) {
+			for (auto& slot : level) {
+				while (slot._next != &slot) {
+					slot._next->unlink();
+				}
+			}
+		}
+	}
+
+	// The last tick advanced to.
+	uint64_t now() const noexcept { return _now; }
+
+	bool empty() const noexcept {
+		for (const auto& level : _wheel) {
+			for (const auto& slot : level) {
+				if (slot._next != &slot) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	// (Re)schedules `hook` to expire at tick `expiry`. Ticks at or before now() expire on the next one.
+	void schedule(timer_wheel_hook& hook, uint64_t expiry) noexcept {
+		hook.unlink();
+		hook._expiry = expiry > _now ? expiry : _now + 1;
+		insert(hook);
+	}
+
+	// Advances to tick `now`, calling `expire(timer_wheel_hook&)` for every hook that falls due, after
+	// unlinking it. The callback may schedule or unlink any hook, including the one it was given.
+	template <typename F>
+	void advance(uint64_t now, F&& expire) {
+		if (now <= _now) {
+			return;
+		}
+		if (empty()) {
+			_now = now;
+			return;
+		}
+		while (_now < now) {
+			step();
+			auto& slot = _wheel[0][_now & (slots - 1)];
+			if (slot._next == &slot) {
+				continue;
+			}
+			// Take the whole slot first so that re-arming from the callback cannot feed it back in.
+			timer_wheel_hook due;
+			due._prev = slot._prev;
+			due._next = slot._next;
+			due._prev->_next = due._next->_prev = &due;
+			slot._prev = slot._next = &slot;
+			while (due._next != &due) {
+				auto& hook = *due._next;
+				hook.unlink();
+				if (hook._expiry > _now) {
+					insert(hook);
+				} else {
+					expire(hook);
+				}
+			}
+			due._prev = due._next = nullptr;
+			if (empty()) {
+				_now = now;
+				return;
+			}
+		}
+	}
+
+private:
+	timer_wheel_hook _wheel[levels][slots];
+	uint64_t _now{0};
+
+	void insert(timer_wheel_hook& hook) noexcept {
+		constexpr uint64_t range = uint64_t(1) << (slot_bits * levels);
+		uint64_t delta = hook._expiry - _now;
+		if (delta >= range) {
+			delta = range - 1;
+		}
+		const uint64_t at = _now + delta;
+		std::size_t level = 0;
+		while (delta >= (uint64_t(1) << (slot_bits * (level + 1)))) {
+			++level;
+		}
+		hook.link_before(_wheel[level][(at >> (slot_bits * level)) & (slots - 1)]);
+	}
+
+	// Moves to the next tick, cascading every higher-level slot that the tick starts.
+	void step() noexcept {
+		++_now;
+		for (std::size_t level = 1; level < levels; ++level) {
+			const unsigned shift = slot_bits * level;
+			if ((_now & ((uint64_t(1) << shift) - 1)) != 0) {
+				break;
+			}
+			auto& slot = _wheel[level][(_now >> shift) & (slots - 1)];
+			while (slot._next != &slot) {
+				auto& hook = *slot._next;
+				hook.unlink();
+				insert(hook);
+			}
+		}
+	}
+};
+
+} // namespace siesta
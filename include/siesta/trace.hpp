@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+/// Sampled request tracing. The phases of one request in N are recorded as spans into a ring
+/// buffer owned by the recording thread, overwriting the oldest once it is full. The rings of all
+/// threads are exported together in the Chrome trace_event JSON format, which chrome://tracing and
+/// Perfetto open directly.
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace siesta {
+
+using trace_clock = std::chrono::steady_clock;
+
+// Spans each thread keeps before overwriting its oldest.
+inline constexpr std::size_t trace_ring_size = 8192;
+// Longest detail kept with a span; longer ones are cut.
+inline constexpr std::size_t trace_detail_size = 47;
+
+// True for one call in `every` on the calling thread; never while `every` is 0.
+inline bool trace_sample(uint32_t every) noexcept {
+	thread_local uint32_t countdown = 0;
+	if (every == 0) {
+		return false;
+	}
+	if (countdown == 0 || countdown > every) {
+		countdown = every;
+	}
+	return --countdown == 0;
+}
+
+// A process-wide id tying the spans of one request together. Never 0.
+uint64_t next_trace_id() noexcept;
+
+// Records a span into the calling thread's ring, which is allocated the first time the thread
+// records; the span is dropped if it cannot be. `category` and `name` must be string literals;
+// `detail` is copied.
+void trace_span(const char* category, const char* name, uint64_t id, trace_clock::time_point begin,
+                trace_clock::time_point end, std::string_view detail = {}) noexcept;
+
+// Appends the spans of all threads as a Chrome trace JSON object to `out`. Spans being written
+// meanwhile are skipped.
+void render_trace(std::string& out);
+
+// Writes render_trace() to a file, replacing it. False if it cannot be written.
+bool dump_trace(const std::string& path);
+
+} // namespace siesta
@@ -1,47 +1,125 @@
 // SPDX-License-Identifier: Apache-2.0
-#include <boost/asio/connect.hpp>
 #include <boost/beast/http/error.hpp>
-#include <iostream>
+#include <sys/socket.h>
 
 #include <siesta/beast/client.hpp>
+#include <siesta/log.hpp>
 
 namespace siesta::beast {
 
-static void fail(std::string_view facility, ::boost::system::error_code ec) {
-	std::cerr << facility << ": " << ec.to_string() << ' ' << ec.message() << std::endl;
+static void fail(const char* facility, const ::boost::system::error_code& ec) {
+	::siesta::log_error(::siesta::log_level::warning, facility, ec);
 }
 
 ClientBase::ClientBase(::boost::asio::io_context& ctx, Config config)
 	: _ctx(ctx)
 	, _conf(std::move(config))
 	, _strand(::boost::asio::make_strand(ctx))
-	, _resolver(_strand)
 	, _stream(_strand) {}
 
 void ClientBase::start(const ::boost::asio::ip::address& address, uint16_t port) {
-	start(protocol::endpoint(address, port));
+	start(::boost::asio::ip::tcp::endpoint(address, port));
 }
-void ClientBase::start(const protocol::endpoint& endpoint) {
+void ClientBase::start(const ::boost::asio::ip::tcp::endpoint& endpoint) {
 	_host_value = endpoint.address().to_string() + ":" + std::to_string(endpoint.port());
-	_resolver.async_resolve(endpoint, [self = shared_from_this()](const error_type& ec, protocol::resolver::results_type results) {
-		self->on_resolve(ec, results);
-	});
+	connect(endpoint);
+}
+void ClientBase::start(const ::boost::asio::local::stream_protocol::endpoint& endpoint) {
+	// Servers on a UNIX domain socket still expect a Host header.
+	_host_value = "localhost";
+	connect(endpoint);
+}
+
+void ClientBase::use_tls(::boost::asio::ssl::context& context, std::string server_name) {
+	_tls_context = &context;
+	_server_name = std::move(server_name);
+	_tls_session.reset();
+}
+
+bool ClientBase::tls_resumed() const { return _tls && SSL_session_reused(_tls->native_handle()) == 1; }
+
+// Keeps the current connection's session for the next one. With TLS 1.3 the server sends its ticket
+// after the handshake, so the session is only taken once the connection is done with.
+void ClientBase::keep_tls_session() noexcept {
+	if (!_tls) {
+		return;
+	}
+	auto* ssl = _tls->native_handle();
+	if (auto* session = SSL_get1_session(ssl); session != nullptr) {
+		if (SSL_SESSION_is_resumable(session) == 1) {
+			_tls_session.reset(session);
+		} else {
+			SSL_SESSION_free(session);
+		}
+	}
+	// Without this, freeing the SSL object would mark the session just kept as not resumable.
+	SSL_set_shutdown(ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+	_tls.reset();
 }
 
-void ClientBase::on_resolve(const error_type& ec, protocol::resolver::results_type results) {
+void ClientBase::connect(const protocol::endpoint& endpoint) {
+	keep_tls_session();
+	if (_tls_context != nullptr) {
+		_tls = std::make_unique<tls_stream>(_stream, *_tls_context);
+		auto* ssl = _tls->native_handle();
+		SSL_set_tlsext_host_name(ssl, _server_name.c_str());
+		_tls->set_verify_callback(::boost::asio::ssl::host_name_verification(_server_name));
+		if (_tls_session) {
+			SSL_set_session(ssl, _tls_session.get());
+		}
+	}
+	// Opened here rather than by async_connect, so that buffer sizes and Fast Open apply to the SYN.
+	auto& socket = _stream.socket();
+	error_type ec;
+	if (socket.is_open()) {
+		socket.close(ec);
+	}
+	socket.open(endpoint.protocol(), ec);
 	if (ec) {
-		return fail("on_resolve", ec);
+		return fail("open", ec);
 	}
+	apply_connect_options(socket.native_handle(), _conf.socket, endpoint.protocol().family() != AF_UNIX);
 	_stream.expires_after(_conf.connect_timeout);
-	_stream.async_connect(results, [self = shared_from_this()](const error_type& ec, protocol::resolver::endpoint_type endpoint) {
-		self->on_connect(ec, endpoint);
+	_stream.async_connect(endpoint, [self = shared_from_this()](const error_type& ec) {
+		self->on_connect(ec);
 	});
 }
 
-void ClientBase::on_connect(const error_type& ec, protocol::resolver::endpoint_type endpoint) {
+void ClientBase::on_connect(const error_type& ec) {
 	if (ec) {
 		return fail("on_connect", ec);
 	}
+	if (_tls) {
+		_stream.expires_after(_conf.connect_timeout);
+		_tls->async_handshake(::boost::asio::ssl::stream_base::client, [self = shared_from_this()](const error_type& ec) {
+			self->on_handshake(ec);
+		});
+	}
+}
+
+void ClientBase::on_handshake(const error_type& ec) {
+	if (ec) {
+		return fail("on_handshake", ec);
+	}
+}
+
+void ClientBase::finish_trace(const CallTrace& trace) const {
+	if (trace.id == 0) {
+		return;
+	}
+	const auto now = ::siesta::trace_clock::now();
+	const auto method = _request.method_string();
+	const auto target = _request.target();
+	std::string detail;
+	detail.append(method.data(), method.size()).append(" ").append(target.data(), target.size());
+	::siesta::trace_span("client", "call", trace.id, trace.start, now, detail);
+	if (trace.sent == ::siesta::trace_clock::time_point{}) {
+		// Failed while writing.
+		::siesta::trace_span("client", "write", trace.id, trace.start, now);
+		return;
+	}
+	::siesta::trace_span("client", "write", trace.id, trace.start, trace.sent);
+	::siesta::trace_span("client", "read", trace.id, trace.sent, now);
 }
 
 } // namespace siesta::beast
@@ -1,112 +1,1550 @@
 // SPDX-License-Identifier: Apache-2.0
+#include <algorithm>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/write.hpp>
 #include <boost/beast/http/write.hpp>
-#include <iostream>
+#include <cerrno>
+#include <charconv>
+#include <ctime>
+#include <fcntl.h>
+#include <memory>
 #include <siesta/beast/server.hpp>
+#include <siesta/beast/socket_options.hpp>
+#include <siesta/compress.hpp>
+#include <siesta/log.hpp>
+#include <span>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/sendfile.h>
+#endif
 
 namespace asio = ::boost::asio;
 namespace http = ::boost::beast::http;
 
 namespace siesta::beast {
 
-static void fail(std::string_view facility, ::boost::system::error_code ec) {
-	std::cerr << facility << ": " << ec.to_string() << ' ' << ec.message() << std::endl;
+static void fail(const char* facility, const ::boost::system::error_code& ec) {
+	::siesta::log_error(::siesta::log_level::error, facility, ec);
+}
+
+// A failure confined to one connection.
+static void warn(const char* facility, const ::boost::system::error_code& ec, uint64_t session) {
+	::siesta::log_error(::siesta::log_level::warning, facility, ec, session);
+}
+
+// "Date: <IMF-fixdate>\r\n", rendered at most once a second per thread.
+static std::string_view date_line() {
+	thread_local std::array<char, 64> line;
+	thread_local std::size_t size = 0;
+	thread_local std::time_t rendered = -1;
+	const auto now = std::time(nullptr);
+	if (now != rendered) {
+		std::tm tm;
+		gmtime_r(&now, &tm);
+		size = std::strftime(line.data(), line.size(), "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tm);
+		rendered = now;
+	}
+	return {line.data(), size};
+}
+
+// Removes a UNIX domain socket file. Anything else at the path is left for bind() to trip over.
+static void remove_socket_file(const std::string& path) {
+	struct stat st;
+	if (::lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+		::unlink(path.c_str());
+	}
+}
+
+static void pin_to_core(std::size_t core) {
+#if defined(__linux__)
+	const auto cores = std::max(std::thread::hardware_concurrency(), 1u);
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(core % cores, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+ServerBase::Shard::Shard(asio::io_context& ctx, bool shared, const Config& config)
+	: ctx(ctx)
+	, acceptor(asio::make_strand(ctx))
+	, shared(shared)
+	, ticker(ctx)
+	, tick(std::max(config.timer_tick, std::chrono::milliseconds{1}))
+	, pool_size(config.pool_size)
+	, pooled_buffer_size(config.pooled_buffer_size) {
+#if defined(SIESTA_IO_URING)
+	register_landing(config);
+#endif
+}
+
+uint64_t ServerBase::Shard::now() const { return std::chrono::steady_clock::now().time_since_epoch() / tick; }
+
+void ServerBase::Shard::arm(Session& session, std::chrono::milliseconds timeout) {
+	std::unique_lock lock(wheel_mutex, std::defer_lock);
+	if (shared) {
+		lock.lock();
+	}
+	if (!ticking) {
+		// The wheel stood still while it was empty; catch it up before scheduling against it.
+		if (wheel.empty()) {
+			wheel.advance(now(), [](::siesta::timer_wheel_hook&) {});
+		}
+		ticking = true;
+		ticker.expires_after(tick);
+		ticker.async_wait([this](const ec_t& ec) { on_tick(ec); });
+	}
+	// Round up, plus one for the part of the current tick that has already gone by.
+	wheel.schedule(session, wheel.now() + (timeout + tick - std::chrono::milliseconds{1}) / tick + 1);
+	++session._deadline_epoch;
+}
+
+void ServerBase::Shard::disarm(Session& session) {
+	std::unique_lock lock(wheel_mutex, std::defer_lock);
+	if (shared) {
+		lock.lock();
+	}
+	session.unlink();
+	++session._deadline_epoch;
+}
+
+void ServerBase::Shard::on_tick(const ec_t& ec) {
+	{
+		std::unique_lock lock(wheel_mutex, std::defer_lock);
+		if (shared) {
+			lock.lock();
+		}
+		if (ec) {
+			ticking = false;
+			return;
+		}
+		wheel.advance(now(), [this](::siesta::timer_wheel_hook& hook) {
+			// A session already retiring, possibly waiting on the lock to unlink itself, needs no close.
+			auto& session = static_cast<Session&>(hook);
+			if (session.try_add_ref()) {
+				expired.emplace_back(Session::Ptr(&session, Session::Ptr::adopt_t{}), session._deadline_epoch);
+			}
+		});
+		if (wheel.empty()) {
+			ticking = false;
+		} else {
+			ticker.expires_after(tick);
+			ticker.async_wait([this](const ec_t& ec) { on_tick(ec); });
+		}
+	}
+	for (auto& [session, epoch] : expired) {
+		if (shared) {
+			auto executor = session->_stream.get_executor();
+			asio::post(executor, [session = std::move(session), epoch = epoch] { session->on_deadline(epoch); });
+		} else {
+			session->on_deadline(epoch);
+		}
+	}
+	expired.clear();
+}
+
+ServerBase::Session::BufferPtr ServerBase::Shard::take_buffer() {
+	std::unique_lock lock(pool_mutex, std::defer_lock);
+	if (shared) {
+		lock.lock();
+	}
+	if (buffers.empty()) {
+		return std::make_unique<::boost::beast::flat_buffer>();
+	}
+	auto buffer = std::move(buffers.back());
+	buffers.pop_back();
+	return buffer;
+}
+
+ServerBase::Session::ExchangePtr ServerBase::Shard::take_exchange() {
+	std::unique_lock lock(pool_mutex, std::defer_lock);
+	if (shared) {
+		lock.lock();
+	}
+	if (exchanges.empty()) {
+		return nullptr;
+	}
+	auto exchange = std::move(exchanges.back());
+	exchanges.pop_back();
+	return exchange;
+}
+
+void ServerBase::Shard::give(Session::BufferPtr buffer) {
+	if (buffer->capacity() > pooled_buffer_size) {
+		return;
+	}
+	std::unique_lock lock(pool_mutex, std::defer_lock);
+	if (shared) {
+		lock.lock();
+	}
+	if (buffers.size() < pool_size) {
+		buffers.push_back(std::move(buffer));
+	}
+}
+
+void ServerBase::Shard::give(Session::ExchangePtr exchange) {
+	std::unique_lock lock(pool_mutex, std::defer_lock);
+	if (shared) {
+		lock.lock();
+	}
+	if (exchanges.size() < pool_size) {
+		exchanges.push_back(std::move(exchange));
+	}
+}
+
+ServerBase::Session::Ptr ServerBase::Shard::take_session(ServerBase& parent) {
+	std::unique_ptr<Session> session;
+	{
+		std::unique_lock lock(pool_mutex, std::defer_lock);
+		if (shared) {
+			lock.lock();
+		}
+		if (!sessions.empty()) {
+			session = std::move(sessions.back());
+			sessions.pop_back();
+		}
+	}
+	if (!session) {
+		session = std::make_unique<Session>(parent, *this);
+	}
+	return Session::Ptr(session.release());
+}
+
+void ServerBase::Shard::give(Session* retired) {
+	std::unique_ptr<Session> session(retired);
+	std::unique_lock lock(pool_mutex, std::defer_lock);
+	if (shared) {
+		lock.lock();
+	}
+	if (sessions.size() < pool_size) {
+		sessions.push_back(std::move(session));
+	}
+}
+
+void ServerBase::Shard::enter(Session& session) {
+	std::unique_lock lock(pool_mutex, std::defer_lock);
+	if (shared) {
+		lock.lock();
+	}
+	session._prev_open = nullptr;
+	session._next_open = open;
+	if (open != nullptr) {
+		open->_prev_open = &session;
+	}
+	open = &session;
+}
+
+void ServerBase::Shard::leave(Session& session) {
+	std::unique_lock lock(pool_mutex, std::defer_lock);
+	if (shared) {
+		lock.lock();
+	}
+	(session._prev_open != nullptr ? session._prev_open->_next_open : open) = session._next_open;
+	if (session._next_open != nullptr) {
+		session._next_open->_prev_open = session._prev_open;
+	}
+	session._prev_open = session._next_open = nullptr;
+}
+
+#if defined(SIESTA_IO_URING)
+void ServerBase::Shard::register_landing(const Config& config) {
+	if (config.registered_buffers == 0 || config.registered_buffer_size == 0) {
+		return;
+	}
+	landing_storage.resize(config.registered_buffers * config.registered_buffer_size);
+	std::vector<asio::mutable_buffer> buffers;
+	buffers.reserve(config.registered_buffers);
+	for (std::size_t i = 0; i < config.registered_buffers; ++i) {
+		buffers.push_back(asio::buffer(landing_storage.data() + i * config.registered_buffer_size,
+		                               config.registered_buffer_size));
+	}
+	// A ring takes one registration; the caller's io_context may hold its own, and RLIMIT_MEMLOCK
+	// may be too low. Either way the shard polls instead.
+	try {
+		landing.emplace(asio::register_buffers(ctx, std::move(buffers)));
+	} catch (const ::boost::system::system_error& e) {
+		fail("register_buffers", e.code());
+		landing_storage = {};
+		return;
+	}
+	free_landing.resize(config.registered_buffers);
+	for (std::size_t i = 0; i < free_landing.size(); ++i) {
+		free_landing[i] = static_cast<int>(free_landing.size() - 1 - i);
+	}
+}
+
+int ServerBase::Shard::take_landing() {
+	std::unique_lock lock(pool_mutex, std::defer_lock);
+	if (shared) {
+		lock.lock();
+	}
+	if (free_landing.empty()) {
+		return -1;
+	}
+	const auto index = free_landing.back();
+	free_landing.pop_back();
+	return index;
+}
+
+void ServerBase::Shard::give_landing(int index) {
+	std::unique_lock lock(pool_mutex, std::defer_lock);
+	if (shared) {
+		lock.lock();
+	}
+	free_landing.push_back(index);
 }
+#endif
 
 ServerBase::ServerBase(asio::io_context& ctx)
-	: _ctx(&ctx)
-	, _acceptor(asio::make_strand(ctx)) {}
+	: _ctx(&ctx) {}
 
 ServerBase::ServerBase(asio::io_context& ctx, Config config)
 	: _conf(std::move(config))
-	, _ctx(&ctx)
-	, _acceptor(asio::make_strand(ctx)) {}
+	, _ctx(&ctx) {}
+
+ServerBase::~ServerBase() noexcept { stop(); }
 
 void ServerBase::start(const asio::ip::address address, uint16_t port) {
-	start(protocol::endpoint(address, port));
+	start(asio::ip::tcp::endpoint(address, port));
+}
+
+void ServerBase::start(const asio::ip::tcp::endpoint& endpoint) {
+	_inet = true;
+	serve(endpoint);
+}
+
+void ServerBase::start(const asio::local::stream_protocol::endpoint& endpoint) {
+	_inet = false;
+	_local_path = endpoint.path();
+	remove_socket_file(_local_path);
+	serve(endpoint);
 }
 
-void ServerBase::start(const protocol::endpoint& endpoint) {
+void ServerBase::serve(const protocol::endpoint& endpoint) {
+	auto threads = _conf.threads != 0 ? _conf.threads : std::thread::hardware_concurrency();
+	threads = std::max<std::size_t>(threads, 1);
+
+	if (_conf.metrics) {
+		_metrics = std::make_unique<::siesta::request_metrics>(endpoint_names().size());
+	}
+	if (_conf.trace_sample != 0 && _conf.trace_signal != 0) {
+		_trace_signals = std::make_unique<asio::signal_set>(*_ctx, _conf.trace_signal);
+		wait_trace_signal();
+	}
+	_shards.push_back(std::make_unique<Shard>(*_ctx, true, _conf));
+	for (std::size_t i = 1; i < threads; ++i) {
+		auto& ctx = *_pool.emplace_back(std::make_unique<asio::io_context>(1));
+		_work.push_back(asio::make_work_guard(ctx));
+		_shards.push_back(std::make_unique<Shard>(ctx, false, _conf));
+	}
+	for (auto& shard : _shards) {
+		if (!listen(*shard, endpoint)) {
+			return stop();
+		}
+	}
+	for (auto& shard : _shards) {
+		do_accept(*shard);
+	}
+	for (std::size_t i = 0; i < _pool.size(); ++i) {
+		_threads.emplace_back([ctx = _pool[i].get(), core = i + 1] {
+			pin_to_core(core);
+			ctx->run();
+		});
+	}
+}
+
+void ServerBase::wait_trace_signal() {
+	_trace_signals->async_wait([this](const ec_t& ec, int) {
+		if (ec) {
+			return;
+		}
+		if (!::siesta::dump_trace(_conf.trace_file)) {
+			fail("dump_trace", ec_t(errno, asio::error::get_system_category()));
+		}
+		wait_trace_signal();
+	});
+}
+
+void ServerBase::stop() {
+	if (_trace_signals) {
+		ec_t ec;
+		_trace_signals->cancel(ec);
+	}
+	_work.clear();
+	for (auto& ctx : _pool) {
+		ctx->stop();
+	}
+	for (auto& thread : _threads) {
+		if (thread.joinable()) {
+			thread.join();
+		}
+	}
+	_threads.clear();
+	if (_offload) {
+		// Handlers it never ran let go of their sessions as the pool is destroyed.
+		_offload->stop();
+		_offload->join();
+		_offload.reset();
+	}
+	for (auto& shard : _shards) {
+		ec_t ec;
+		shard->acceptor.close(ec);
+		shard->ticker.cancel();
+	}
+	// Every open connection is closed as if it had timed out, so that none of its handlers still
+	// queued starts another request. Those handlers hold the sessions, which return to their shards
+	// as the handlers run; run them now, while the shards are still there.
+	std::vector<Session::Ptr> open;
+	for (auto& shard : _shards) {
+		std::unique_lock lock(shard->pool_mutex, std::defer_lock);
+		if (shard->shared) {
+			lock.lock();
+		}
+		for (auto* session = shard->open; session != nullptr; session = session->_next_open) {
+			if (session->try_add_ref()) {
+				open.push_back(Session::Ptr(session, Session::Ptr::adopt_t{}));
+			}
+		}
+	}
+	for (auto& session : open) {
+		session->_timed_out = session->_stopping = true;
+		session->do_close();
+	}
+	open.clear();
+	for (auto& ctx : _pool) {
+		ctx->restart();
+		ctx->poll();
+	}
+	if (_ctx->stopped()) {
+		_ctx->restart();
+		_ctx->poll();
+		_ctx->stop();
+	}
+	if (!_local_path.empty()) {
+		remove_socket_file(_local_path);
+		_local_path.clear();
+	}
+}
+
+asio::thread_pool& ServerBase::offload_pool() {
+	std::call_once(_offload_once, [this] {
+		_offload = std::make_unique<asio::thread_pool>(std::max<std::size_t>(_conf.offload_threads, 1));
+	});
+	return *_offload;
+}
+
+bool ServerBase::admit_offload(Session& session) {
+	if (_offload_pending.fetch_add(1, std::memory_order_relaxed) < _conf.offload_queue) {
+		return true;
+	}
+	_offload_pending.fetch_sub(1, std::memory_order_relaxed);
+	_shed_offload.fetch_add(1, std::memory_order_relaxed);
+	auto& res = session.get_response();
+	res.result(http::status::service_unavailable);
+	res.set(http::field::retry_after, "1");
+	res.body().clear();
+	session.write();
+	return false;
+}
+
+void ServerBase::offload(Session::Ptr session, std::function<void()> handler) {
+	if (!admit_offload(*session)) {
+		return;
+	}
+	session->share();
+	asio::post(offload_pool(), [this, session = std::move(session), handler = std::move(handler)] {
+		try {
+			handler();
+		} catch (...) {
+			auto& res = session->get_response();
+			res.result(http::status::internal_server_error);
+			res.body().clear();
+			session->write();
+		}
+		_offload_pending.fetch_sub(1, std::memory_order_relaxed);
+	});
+}
+
+void ServerBase::offload(Session::Ptr session, asio::awaitable<void> handler) {
+	if (!admit_offload(*session)) {
+		return;
+	}
+	session->share();
+	asio::co_spawn(offload_pool(), std::move(handler), [this, session = std::move(session)](std::exception_ptr e) {
+		_offload_pending.fetch_sub(1, std::memory_order_relaxed);
+		if (e) {
+			auto& res = session->get_response();
+			res.result(http::status::internal_server_error);
+			res.body().clear();
+		}
+		session->write();
+	});
+}
+
+ServerBase::AdmissionStats ServerBase::admission_stats() const noexcept {
+	constexpr auto relaxed = std::memory_order_relaxed;
+	return {
+		_connections.load(relaxed),    _in_flight.load(relaxed),  _shed_connections.load(relaxed),
+		_shed_in_flight.load(relaxed), _shed_queue.load(relaxed), _shed_offload.load(relaxed),
+	};
+}
+
+std::span<const std::string_view> ServerBase::endpoint_names() const noexcept {
+	static constexpr std::array<std::string_view, 1> names{"other"};
+	return names;
+}
+
+void ServerBase::render_metrics(std::string& out) const {
+	if (!_metrics) {
+		return;
+	}
+	const auto names = endpoint_names();
+	auto snapshot = _metrics->collect();
+	snapshot.endpoints.resize(names.size());
+	::siesta::render_prometheus(out, snapshot, names);
+	const auto stats = admission_stats();
+	::siesta::render_prometheus_value(out, "siesta_connections_open", "gauge", "Connections open now.",
+	                                  stats.connections);
+	::siesta::render_prometheus_value(out, "siesta_shed_connections_total", "counter",
+	                                  "Connections closed at accept time over max_connections.",
+	                                  stats.shed_connections);
+	::siesta::render_prometheus_value(out, "siesta_shed_in_flight_total", "counter",
+	                                  "Requests answered 503 over max_in_flight.", stats.shed_in_flight);
+	::siesta::render_prometheus_value(out, "siesta_shed_queue_total", "counter",
+	                                  "Requests answered 503 by queue-time control.", stats.shed_queue);
+	::siesta::render_prometheus_value(out, "siesta_shed_offload_total", "counter",
+	                                  "Requests answered 503 with the offload queue full.", stats.shed_offload);
+}
+
+bool ServerBase::admit(const Session::Exchange& exchange) {
+	if (_conf.queue_target.count() != 0 &&
+	    over_queue_target(std::chrono::steady_clock::now() - exchange.parsed)) {
+		_shed_queue.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	if (_conf.max_in_flight != 0 && _in_flight.fetch_add(1, std::memory_order_relaxed) >= _conf.max_in_flight) {
+		_in_flight.fetch_sub(1, std::memory_order_relaxed);
+		_shed_in_flight.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	return true;
+}
+
+// CoDel as adapted for request queues: an interval whose shortest queue time stays above the target
+// means a standing queue rather than a burst, and during the next interval requests that have
+// already waited twice the target are dropped. The shards update the state without a lock; a lost
+// update only blurs an interval boundary.
+bool ServerBase::over_queue_target(std::chrono::steady_clock::duration delay) {
+	constexpr auto relaxed = std::memory_order_relaxed;
+	const auto target = std::chrono::steady_clock::duration(_conf.queue_target).count();
+	const auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+	const auto sample = delay.count();
+	auto end = _codel_interval_end.load(relaxed);
+	if (now > end) {
+		if (_codel_interval_end.compare_exchange_strong(
+				end, now + std::chrono::steady_clock::duration(_conf.queue_interval).count(), relaxed)) {
+			_codel_overloaded.store(_codel_min_delay.exchange(sample, relaxed) > target, relaxed);
+		}
+	} else {
+		auto min = _codel_min_delay.load(relaxed);
+		while (sample < min && !_codel_min_delay.compare_exchange_weak(min, sample, relaxed)) {
+		}
+	}
+	return _codel_overloaded.load(relaxed) && sample > 2 * target;
+}
+
+bool ServerBase::listen(Shard& shard, const protocol::endpoint& endpoint) {
+	auto& acceptor = shard.acceptor;
 	auto ec = ec_t{};
-	_acceptor.open(endpoint.protocol(), ec);
+	// UNIX domain sockets have no SO_REUSEPORT. The other shards accept from duplicates of the first
+	// shard's listening socket instead, each on its own io_context.
+	if (!_inet && &shard != _shards.front().get()) {
+		const int fd = ::dup(_shards.front()->acceptor.native_handle());
+		if (fd < 0) {
+			fail("dup", ec_t(errno, ::boost::system::system_category()));
+			return false;
+		}
+		acceptor.assign(endpoint.protocol(), fd, ec);
+		if (ec) {
+			::close(fd);
+			fail("acceptor::assign", ec);
+			return false;
+		}
+		return true;
+	}
+	acceptor.open(endpoint.protocol(), ec);
 	if (ec) {
-		return fail("acceptor::open", ec);
+		fail("acceptor::open", ec);
+		return false;
+	}
+	acceptor.set_option(protocol::socket::reuse_address(true), ec);
+	apply_listener_options(acceptor.native_handle(), _conf.socket, _inet);
+#ifdef SO_REUSEPORT
+	if (_inet && _shards.size() > 1) {
+		using reuse_port = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+		acceptor.set_option(reuse_port(true), ec);
+		if (ec) {
+			fail("acceptor::set_option", ec);
+			return false;
+		}
 	}
-	_acceptor.set_option(protocol::socket::reuse_address(true), ec);
-	_acceptor.bind(endpoint, ec);
+#endif
+	acceptor.bind(endpoint, ec);
 	if (ec) {
-		return fail("acceptor::bind", ec);
+		fail("acceptor::bind", ec);
+		return false;
 	}
-	_acceptor.listen(64, ec);
+	acceptor.listen(_conf.socket.backlog, ec);
 	if (ec) {
-		return fail("acceptor::listen", ec);
+		fail("acceptor::listen", ec);
+		return false;
 	}
-	_acceptor.async_accept(asio::make_strand(*_ctx), [this](const ec_t& ec, protocol::socket socket) {
-		on_accept(ec, std::move(socket));
+	return true;
+}
+
+void ServerBase::do_accept(Shard& shard) {
+	// The caller may run its io_context from several threads, so its sessions get a strand.
+	// Owned io_contexts are run by exactly one thread and need none.
+	auto executor = shard.shared ? asio::any_io_executor(asio::make_strand(shard.ctx))
+	                             : asio::any_io_executor(shard.ctx.get_executor());
+	shard.acceptor.async_accept(executor, [this, &shard](const ec_t& ec, protocol::socket socket) {
+		on_accept(shard, ec, std::move(socket));
 	});
 }
 
-void ServerBase::on_accept(const ec_t& ec, protocol::socket socket) {
+void ServerBase::on_accept(Shard& shard, const ec_t& ec, protocol::socket socket) {
+	if (ec == asio::error::operation_aborted) {
+		return;
+	}
 	if (ec) {
 		return fail("on_accept", ec);
 	}
-	std::make_shared<Session>(*this, std::move(socket), _conf, _client_id++)->run();
-	_acceptor.async_accept(asio::make_strand(*_ctx), [this](const ec_t& ec, protocol::socket socket) {
-		on_accept(ec, std::move(socket));
-	});
+	if (_conf.max_connections != 0 && _connections.load(std::memory_order_relaxed) >= _conf.max_connections) {
+		// Refused: the socket closes as it goes out of scope.
+		_shed_connections.fetch_add(1, std::memory_order_relaxed);
+		return do_accept(shard);
+	}
+	// Pipelined responses go out as back-to-back small writes; Nagle would hold each one back
+	// until the previous is acknowledged, hence no_delay by default.
+	apply_accepted_options(socket.native_handle(), _conf.socket, _inet);
+	auto session = shard.take_session(*this);
+	session->open(std::move(socket), _client_id++);
+	session->run();
+	do_accept(shard);
 }
 
 // Session
 
-ServerBase::Session::Session(ServerBase& parent, protocol::socket socket, Config config, uint64_t id)
+ServerBase::Session::Exchange::Exchange(std::size_t size)
+	: storage(std::make_unique<std::byte[]>(size))
+	, arena(storage.get(), size)
+	, req(std::piecewise_construct, std::make_tuple(allocator_type(&arena)), std::make_tuple(allocator_type(&arena)))
+	, res(std::piecewise_construct, std::make_tuple(allocator_type(&arena)), std::make_tuple(allocator_type(&arena)))
+	, head(allocator_type(&arena))
+	, packed(allocator_type(&arena)) {}
+
+void ServerBase::Session::Exchange::reset() {
+	// Drop the old messages before rewinding the arena their storage came from. They are destroyed
+	// and rebuilt rather than assigned to: a string move-assigned from a short one keeps its old
+	// buffer, which would then overlap whatever the rewound arena hands out next.
+	parser.reset();
+	if (decoder != nullptr) {
+		std::destroy_at(std::exchange(decoder, nullptr));
+	}
+	std::destroy_at(&req);
+	std::destroy_at(&res);
+	std::destroy_at(&head);
+	std::destroy_at(&packed);
+	arena.release();
+	const allocator_type alloc(&arena);
+	std::construct_at(&req, std::piecewise_construct, std::make_tuple(alloc), std::make_tuple(alloc));
+	std::construct_at(&res, std::piecewise_construct, std::make_tuple(alloc), std::make_tuple(alloc));
+	std::construct_at(&head, alloc);
+	std::construct_at(&packed, alloc);
+	headers = nullptr;
+	resolution = {};
+	rejected = false;
+}
+
+ServerBase::Session::Session(ServerBase& parent, Shard& shard)
 	: _parent(parent)
-	, _stream(std::move(socket))
-	, _config(std::move(config))
-	, _id(id) {}
+	, _shard(shard)
+	, _stream(shard.ctx)
+	, _config(parent._conf)
+	, _confined(!shard.shared) {}
 
-ServerBase::Session::~Session() noexcept { do_close(); }
+void ServerBase::Session::open(protocol::socket socket, uint64_t id) {
+	_stream = std::move(socket);
+	if (_parent._tls_context != nullptr) {
+		_tls = std::make_unique<tls_stream>(_stream, *_parent._tls_context);
+	}
+	_id = id;
+	_confined = !_shard.shared;
+	_reading = _waiting = _writing = _eof = _timed_out = _stopping = _shed = false;
+	_fresh = true;
+	if (_config.trace_sample != 0) {
+		_opened = std::chrono::steady_clock::now();
+	}
+	_parent._connections.fetch_add(1, std::memory_order_relaxed);
+	if (_parent._metrics) {
+		_parent._metrics->count_connection();
+	}
+	_shard.enter(*this);
+}
+
+void ServerBase::Session::add_ref() noexcept {
+	if (_confined) {
+		_refs.store(_refs.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	} else {
+		_refs.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void ServerBase::Session::release() noexcept {
+	if (_confined) {
+		const auto refs = _refs.load(std::memory_order_relaxed) - 1;
+		_refs.store(refs, std::memory_order_relaxed);
+		if (refs == 0) {
+			retire();
+		}
+		return;
+	}
+	if (_refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+		return;
+	}
+	// The shared shard guards its wheel and pools with mutexes. An owned shard's belong to its
+	// thread, so a shared session whose last handle went away elsewhere is retired over there.
+	if (_shard.shared || _shard.ctx.stopped() || _shard.ctx.get_executor().running_in_this_thread()) {
+		return retire();
+	}
+	asio::post(_shard.ctx, [this] { retire(); });
+}
+
+bool ServerBase::Session::try_add_ref() noexcept {
+	auto refs = _refs.load(std::memory_order_relaxed);
+	do {
+		if (refs == 0) {
+			return false;
+		}
+	} while (!_refs.compare_exchange_weak(refs, refs + 1, std::memory_order_relaxed));
+	return true;
+}
+
+// Closes the connection and hands the session back to its shard once the last Ptr is gone.
+void ServerBase::Session::retire() noexcept {
+	// A handler dropped the session without answering.
+	if (_current != nullptr && !_shed && _config.max_in_flight != 0) {
+		_parent._in_flight.fetch_sub(1, std::memory_order_relaxed);
+	}
+	_parent._connections.fetch_sub(1, std::memory_order_relaxed);
+	_shard.leave(*this);
+	_shard.disarm(*this);
+	do_close();
+	// Whatever is left unparsed or unanswered is dropped; the storage goes back to the shard.
+	if (_incoming) {
+		recycle(std::move(_incoming));
+	}
+	for (auto& exchange : _pipeline) {
+		recycle(std::move(exchange));
+	}
+	_pipeline.clear();
+	_current = nullptr;
+	if (_buffer) {
+		_buffer->clear();
+	}
+	release_idle();
+	if (_tls) {
+		// Freeing an SSL object that never shut down evicts its session from the cache, and HTTP
+		// connections routinely end without close_notify. Sessions a fatal alert spoiled were
+		// evicted already.
+		SSL_set_shutdown(_tls->native_handle(), SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+		_tls.reset();
+	}
+	_shard.give(this);
+}
 
 void ServerBase::Session::run() {
-	asio::post(_stream.get_executor(), [self = shared_from_this()] {
+	asio::post(_stream.get_executor(), [self = Ptr(this)] {
+		if (self->_tls) {
+			return self->handshake();
+		}
 		self->do_read();
 	});
 }
 
+void ServerBase::Session::handshake() {
+	_shard.arm(*this, _config.handshake_timeout);
+	_tls->async_handshake(asio::ssl::stream_base::server, [self = Ptr(this)](ec_t ec) {
+		self->on_handshake(ec);
+	});
+}
+
+void ServerBase::Session::on_handshake(ec_t ec) {
+	_shard.disarm(*this);
+	if (ec || _timed_out) {
+		if (!_timed_out) {
+			warn("on_handshake", ec, _id);
+		}
+		return do_close();
+	}
+	do_read();
+}
+
+ServerBase::Session::ExchangePtr ServerBase::Session::acquire() {
+	if (_spare.empty()) {
+		if (auto exchange = _shard.take_exchange()) {
+			return exchange;
+		}
+		return std::make_unique<Exchange>(_config.arena_size);
+	}
+	auto exchange = std::move(_spare.back());
+	_spare.pop_back();
+	return exchange;
+}
+
+void ServerBase::Session::recycle(ExchangePtr exchange) {
+	exchange->reset();
+	_spare.push_back(std::move(exchange));
+}
+
+// Hands the read buffer, unless it still holds the start of the next request, and the spare
+// exchanges back to the shard. An idle keep-alive session then holds little more than its socket.
+void ServerBase::Session::release_idle() {
+	if (_buffer && _buffer->size() == 0) {
+		_shard.give(std::move(_buffer));
+	}
+	for (auto& exchange : _spare) {
+		_shard.give(std::move(exchange));
+	}
+	_spare.clear();
+}
+
 void ServerBase::Session::write() {
-	_response.prepare_payload();
-	_stream.expires_after(_config.write_timeout);
-	http::async_write(_stream, _response, [self = shared_from_this()](ec_t ec, std::size_t bytes) {
-		self->on_write(ec, bytes);
+	// Runs inline when already on the session's executor, which is the common case.
+	asio::dispatch(_stream.get_executor(), [self = Ptr(this)] {
+		self->do_write();
+	});
+}
+
+// The Content-Length a handler set itself, if it is a number.
+static std::optional<uint64_t> declared_length(const ServerBase::response& res) {
+	const auto field = res[http::field::content_length];
+	uint64_t length = 0;
+	const auto [end, error] = std::from_chars(field.data(), field.data() + field.size(), length);
+	if (field.empty() || error != std::errc{} || end != field.data() + field.size()) {
+		return std::nullopt;
+	}
+	return length;
+}
+
+void ServerBase::Session::do_write() {
+	auto& res = _current->res;
+	_writing = true;
+	if (_current->timed) {
+		_current->writing = std::chrono::steady_clock::now();
+	}
+	_shard.arm(*this, _config.write_timeout);
+	// Answers without a body get the same head and static lines, and no body. HEAD is told the
+	// length and coding GET would get; 1xx and 204 never carry a length, and 304 only its handler's.
+	const auto status = res.result_int();
+	if (_current->req.method() == http::verb::head || status < 200 || status == 204 || status == 304) {
+		std::optional<uint64_t> length;
+		if (status == 304) {
+			length = declared_length(res);
+		} else if (status >= 200 && status != 204) {
+			length = res.body().empty() ? declared_length(res).value_or(0) : encode_body().size();
+		}
+		render_head(length);
+		with_stream([&](auto& stream) {
+			asio::async_write(stream, head_buffers(), [self = Ptr(this)](ec_t ec, std::size_t bytes) {
+				self->on_write(ec, bytes);
+			});
+		});
+		return;
+	}
+	// One gather write: rendered head, the endpoint's static lines, the blank line and the body.
+	const auto body = encode_body();
+	render_head(body.size());
+	const auto head = head_buffers();
+	const std::array<asio::const_buffer, 4> buffers{head[0], head[1], head[2], body};
+	with_stream([&](auto& stream) {
+		asio::async_write(stream, buffers, [self = Ptr(this)](ec_t ec, std::size_t bytes) {
+			self->on_write(ec, bytes);
+		});
+	});
+}
+
+// Adds Accept-Encoding to the response's Vary, merged into whatever the handler listed there so
+// that the field is sent once. Nothing changes when it is already listed, or the list is "*".
+static void vary_on_accept_encoding(ServerBase::response& res) {
+	static constexpr ::boost::beast::string_view accept_encoding = "Accept-Encoding";
+	const auto [first, last] = res.equal_range(http::field::vary);
+	if (first == last) {
+		res.insert(http::field::vary, accept_encoding);
+		return;
+	}
+	std::string merged;
+	for (auto it = first; it != last; ++it) {
+		for (const auto token : http::token_list(it->value())) {
+			if (token == "*" || ::boost::beast::iequals(token, accept_encoding)) {
+				return;
+			}
+		}
+		merged.append(it->value().data(), it->value().size()).append(", ");
+	}
+	merged.append(accept_encoding.data(), accept_encoding.size());
+	res.set(http::field::vary, merged);
+}
+
+// Compresses the body into the exchange's arena when it is large enough and the client accepts a
+// coding, and marks the response accordingly. Returns the body bytes to send.
+asio::const_buffer ServerBase::Session::encode_body() {
+	auto& res = _current->res;
+	const auto& body = res.body();
+	const auto plain = asio::buffer(body.data(), body.size());
+	if (_config.compress_min_size == 0 || body.size() < _config.compress_min_size ||
+	    res.count(http::field::content_encoding) != 0) {
+		return plain;
+	}
+	// The representation now depends on Accept-Encoding, whichever coding ends up being sent.
+	vary_on_accept_encoding(res);
+	const auto accept = _current->req[http::field::accept_encoding];
+	const auto coding = ::siesta::negotiate_coding({accept.data(), accept.size()});
+	if (coding == ::siesta::coding::identity) {
+		return plain;
+	}
+	auto& packed = _current->packed;
+	packed.resize(::siesta::compress_bound(coding, body.size()));
+	const auto size = ::siesta::compress(coding, _config.compress_level, {body.data(), body.size()}, packed.data());
+	// Bodies that do not shrink go out as they are.
+	if (size == 0 || size >= body.size()) {
+		return plain;
+	}
+	packed.resize(size);
+	const auto name = ::siesta::coding_name(coding);
+	res.set(http::field::content_encoding, {name.data(), name.size()});
+	return asio::buffer(packed.data(), packed.size());
+}
+
+// Renders the status line, the handler's own fields, Date and the Content-Length, when given,
+// into the exchange's head.
+void ServerBase::Session::render_head(std::optional<uint64_t> content_length) {
+	const auto& res = _current->res;
+	const auto status = res.result_int();
+	auto& head = _current->head;
+	head.clear();
+	head.append(res.version() == 10 ? "HTTP/1.0 " : "HTTP/1.1 ");
+	std::array<char, 20> number;
+	head.append(number.data(), std::to_chars(number.data(), number.data() + number.size(), status).ptr);
+	head.push_back(' ');
+	const auto reason = res.reason();
+	head.append(reason.data(), reason.size());
+	head.append("\r\n");
+	// Usually empty: the Content-Type and Server lines come from the static block.
+	for (const auto& field : res) {
+		if (field.name() == http::field::content_length || field.name() == http::field::transfer_encoding) {
+			continue;
+		}
+		const auto name = field.name_string();
+		const auto value = field.value();
+		head.append(name.data(), name.size()).append(": ").append(value.data(), value.size()).append("\r\n");
+	}
+	head.append(date_line());
+	if (!content_length) {
+		return;
+	}
+	head.append("Content-Length: ");
+	head.append(number.data(), std::to_chars(number.data(), number.data() + number.size(), *content_length).ptr);
+	head.append("\r\n");
+}
+
+// The rendered head, the endpoint's static lines and the blank line that ends the header.
+std::array<asio::const_buffer, 3> ServerBase::Session::head_buffers() const {
+	static constexpr std::string_view crlf = "\r\n";
+	auto lines = _current->headers != nullptr ? _current->headers->lines : std::string_view{};
+	if (!lines.empty() && _current->res.count(http::field::content_type) != 0) {
+		lines.remove_prefix(_current->headers->content_type);
+	}
+	return {
+		asio::buffer(_current->head.data(), _current->head.size()),
+		asio::buffer(lines.data(), lines.size()),
+		asio::buffer(crlf.data(), crlf.size()),
+	};
+}
+
+ServerBase::Session::BodySource::~BodySource() {
+	if (fd >= 0) {
+		::close(fd);
+	}
+}
+
+void ServerBase::Session::write_chunked(ChunkSource source) {
+	auto body = std::make_unique<BodySource>();
+	body->chunks = std::move(source);
+	asio::dispatch(_stream.get_executor(), [self = Ptr(this), body = std::move(body)]() mutable {
+		self->_body = std::move(body);
+		self->do_write_chunked();
+	});
+}
+
+bool ServerBase::Session::write_file(const std::string& path) {
+	const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+	auto body = std::make_unique<BodySource>();
+	body->fd = fd;
+	struct stat st;
+	if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+		return false;
+	}
+	body->remaining = static_cast<uint64_t>(st.st_size);
+	asio::dispatch(_stream.get_executor(), [self = Ptr(this), body = std::move(body)]() mutable {
+		self->_body = std::move(body);
+		self->do_write_file();
+	});
+	return true;
+}
+
+void ServerBase::Session::do_write_chunked() {
+	auto& res = _current->res;
+	if (res.version() < 11) {
+		// No chunked encoding before HTTP/1.1: gather the whole body instead.
+		auto body = std::move(_body);
+		try {
+			while (body->chunks(body->chunk)) {
+			}
+			res.body().assign(body->chunk.data(), body->chunk.size());
+		} catch (...) {
+			res.result(http::status::internal_server_error);
+			res.body().clear();
+		}
+		return do_write();
+	}
+	_writing = true;
+	if (_current->timed) {
+		_current->writing = std::chrono::steady_clock::now();
+	}
+	_shard.arm(*this, _config.write_timeout);
+	render_head(std::nullopt);
+	_current->head.append("Transfer-Encoding: chunked\r\n");
+	with_stream([&](auto& stream) {
+		asio::async_write(stream, head_buffers(), [self = Ptr(this)](ec_t ec, std::size_t bytes) {
+			self->next_chunk(ec, bytes);
+		});
+	});
+}
+
+void ServerBase::Session::next_chunk(ec_t ec, std::size_t bytes) {
+	static constexpr std::string_view crlf = "\r\n";
+	static constexpr std::string_view last_chunk = "0\r\n\r\n";
+	auto& body = *_body;
+	body.sent += bytes;
+	if (ec || body.last || _current->req.method() == http::verb::head) {
+		return on_write(ec, 0);
+	}
+	body.chunk.clear();
+	bool more = true;
+	try {
+		while (more && body.chunk.empty()) {
+			more = body.chunks(body.chunk);
+		}
+	} catch (...) {
+		// The status line is already out; all that is left is to cut the response short.
+		return abort_write(asio::error::connection_aborted);
+	}
+	body.last = !more;
+	auto& buffers = body.pieces;
+	std::size_t count = 0;
+	if (!body.chunk.empty()) {
+		auto& line = body.size_line;
+		auto end = std::to_chars(line.data(), line.data() + line.size() - 2, body.chunk.size(), 16).ptr;
+		*end++ = '\r';
+		*end++ = '\n';
+		buffers[count++] = asio::buffer(line.data(), end - line.data());
+		buffers[count++] = asio::buffer(body.chunk.data(), body.chunk.size());
+		buffers[count++] = asio::buffer(crlf.data(), crlf.size());
+	}
+	if (body.last) {
+		buffers[count++] = asio::buffer(last_chunk.data(), last_chunk.size());
+	}
+	_shard.arm(*this, _config.write_timeout);
+	with_stream([&](auto& stream) {
+		asio::async_write(stream, std::span<const asio::const_buffer>(buffers.data(), count),
+		                  [self = Ptr(this)](ec_t ec, std::size_t bytes) { self->next_chunk(ec, bytes); });
+	});
+}
+
+void ServerBase::Session::do_write_file() {
+	_writing = true;
+	if (_current->timed) {
+		_current->writing = std::chrono::steady_clock::now();
+	}
+	_shard.arm(*this, _config.write_timeout);
+	render_head(_body->remaining);
+	with_stream([&](auto& stream) {
+		asio::async_write(stream, head_buffers(), [self = Ptr(this)](ec_t ec, std::size_t bytes) {
+			self->next_file_piece(ec, bytes);
+		});
+	});
+}
+
+void ServerBase::Session::next_file_piece(ec_t ec, std::size_t bytes) {
+	auto& body = *_body;
+	body.sent += bytes;
+	if (ec || body.remaining == 0 || _current->req.method() == http::verb::head) {
+		return on_write(ec, 0);
+	}
+	_shard.arm(*this, _config.write_timeout);
+#if defined(__linux__)
+	// TLS encrypts in user space, so only plaintext connections can use sendfile.
+	if (!_tls) {
+		return send_file_piece();
+	}
+#endif
+	body.chunk.resize(static_cast<std::size_t>(std::min<uint64_t>(body.remaining, 64 * 1024)));
+	const auto got = ::pread(body.fd, body.chunk.data(), body.chunk.size(), static_cast<off_t>(body.offset));
+	if (got <= 0) {
+		return abort_write(got == 0 ? ec_t(asio::error::eof) : ec_t(errno, asio::error::get_system_category()));
+	}
+	body.offset += got;
+	body.remaining -= got;
+	with_stream([&](auto& stream) {
+		asio::async_write(stream, asio::buffer(body.chunk.data(), got),
+		                  [self = Ptr(this)](ec_t ec, std::size_t bytes) { self->next_file_piece(ec, bytes); });
+	});
+}
+
+#if defined(__linux__)
+// Straight from the page cache into the socket, until the socket buffer is full; then waits for room
+// and carries on.
+void ServerBase::Session::send_file_piece() {
+	auto& body = *_body;
+	ec_t ec;
+	_stream.native_non_blocking(true, ec);
+	while (!ec && body.remaining != 0) {
+		auto offset = static_cast<off_t>(body.offset);
+		const auto count = static_cast<std::size_t>(std::min<uint64_t>(body.remaining, 1 << 20));
+		const auto sent = ::sendfile(_stream.native_handle(), body.fd, &offset, count);
+		if (sent > 0) {
+			body.offset += sent;
+			body.remaining -= sent;
+			body.sent += sent;
+		} else if (sent == 0) {
+			ec = asio::error::eof; // the file shrank under us
+		} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			return _stream.async_wait(protocol::socket::wait_write, [self = Ptr(this)](ec_t ec) {
+				self->next_file_piece(ec, 0);
+			});
+		} else if (errno != EINTR) {
+			ec = ec_t(errno, asio::error::get_system_category());
+		}
+	}
+	if (ec) {
+		return abort_write(ec);
+	}
+	on_write(ec, 0);
+}
+#endif
+
+// A streamed body failed after its header went out. The response cannot be completed, so the
+// connection is closed.
+void ServerBase::Session::abort_write(ec_t ec) {
+	do_close();
+	on_write(ec, 0);
+}
+
+void ServerBase::Session::spawn(asio::awaitable<void> handler) {
+	asio::co_spawn(_stream.get_executor(), std::move(handler), [self = Ptr(this)](std::exception_ptr e) {
+		if (e) {
+			auto& res = self->get_response();
+			res.result(http::status::internal_server_error);
+			res.body().clear();
+		}
+		self->write();
 	});
 }
 
 void ServerBase::Session::do_read() {
-	_request = {};
-	_stream.expires_after(_config.read_timeout);
-	http::async_read(_stream, _buffer, _request, [self = shared_from_this()](ec_t ec, std::size_t bytes) {
-		self->on_read(ec, bytes);
+	_reading = true;
+	// A pending write's deadline covers the read-ahead until the write completes.
+	if (!_writing) {
+		_shard.arm(*this, _config.read_timeout);
+	}
+	// A TLS session may hold decrypted bytes the socket no longer shows as readable, so it reads
+	// straight away and keeps its buffer while idle.
+	if ((_buffer && _buffer->size() != 0) || _tls) {
+		return start_read();
+	}
+	// Nothing buffered: wait for the socket to become readable before claiming a buffer and an
+	// exchange, so a session idling between requests holds neither.
+	_waiting = true;
+	if (_pipeline.empty()) {
+		release_idle();
+	}
+#if defined(SIESTA_IO_URING)
+	// One fixed-buffer read does the work of the poll and the first read. The buffer belongs to the
+	// shard, so the session still holds nothing of its own while idle.
+	if (_landing = _shard.take_landing(); _landing >= 0) {
+		_stream.async_read_some((*_shard.landing)[_landing], [self = Ptr(this)](ec_t ec, std::size_t bytes) {
+			self->on_landed(ec, bytes);
+		});
+		return;
+	}
+#endif
+	_stream.async_wait(protocol::socket::wait_read, [self = Ptr(this)](ec_t ec) {
+		self->on_readable(ec);
+	});
+}
+
+void ServerBase::Session::on_readable(ec_t ec) {
+	_waiting = false;
+	if (ec || _timed_out) {
+		return on_read(ec, 0);
+	}
+	start_read();
+}
+
+#if defined(SIESTA_IO_URING)
+void ServerBase::Session::on_landed(ec_t ec, std::size_t bytes) {
+	_waiting = false;
+	const auto landing = std::exchange(_landing, -1);
+	if (!ec && !_timed_out) {
+		if (!_buffer) {
+			_buffer = _shard.take_buffer();
+		}
+		const auto& landed = (*_shard.landing)[landing].buffer();
+		_buffer->commit(asio::buffer_copy(_buffer->prepare(bytes), asio::buffer(landed.data(), bytes)));
+	}
+	_shard.give_landing(landing);
+	if (ec == asio::error::eof) {
+		// The peer closed between requests, as the parser would have reported it.
+		ec = http::error::end_of_stream;
+	}
+	if (ec || _timed_out) {
+		return on_read(ec, 0);
+	}
+	start_read();
+}
+#endif
+
+void ServerBase::Session::start_read() {
+	if (!_buffer) {
+		_buffer = _shard.take_buffer();
+	}
+	_incoming = acquire();
+	_incoming->trace_id = ::siesta::trace_sample(_config.trace_sample) ? ::siesta::next_trace_id() : 0;
+	_incoming->timed = _parent._metrics || _incoming->trace_id != 0;
+	if (_incoming->timed) {
+		_incoming->read = std::chrono::steady_clock::now();
+	}
+	// A sampled first request also shows how long its connection took from accept, handshake
+	// included, to the request's first byte.
+	if (std::exchange(_fresh, false) && _incoming->trace_id != 0) {
+		::siesta::trace_span("server", "accept", _incoming->trace_id, _opened, _incoming->read);
+	}
+	// The header is read on its own so that the body limit can be picked, and an oversized body
+	// refused, before any of the body is read.
+	const allocator_type alloc(&_incoming->arena);
+	auto& parser = _incoming->parser.emplace(std::piecewise_construct, std::make_tuple(alloc), std::make_tuple(alloc));
+	with_stream([&](auto& stream) {
+		http::async_read_header(stream, *_buffer, parser, [self = Ptr(this)](ec_t ec, std::size_t) {
+			self->on_header(ec);
+		});
+	});
+}
+
+void ServerBase::Session::on_header(ec_t ec) {
+	if (ec || _timed_out) {
+		return on_read(ec, 0);
+	}
+	if (_incoming->timed) {
+		_incoming->header = std::chrono::steady_clock::now();
+	}
+	auto& parser = *_incoming->parser;
+	auto& req = parser.get();
+	_incoming->resolution = _parent.resolve(req, _incoming->arena);
+	const auto limit = _parent.body_limit(req, _incoming->resolution);
+	if (const auto length = parser.content_length(); length && *length > limit) {
+		_incoming->rejected = true;
+		return on_read({}, 0);
+	}
+	parser.body_limit(limit);
+	if (parser.is_done()) {
+		return on_read({}, 0);
+	}
+	_incoming->decoder = req.body().decoder = _parent.body_decoder(req, _incoming->resolution, _incoming->arena);
+	// Only when nothing else is being answered, so that the interim response cannot land in the
+	// middle of another; a client that gets none sends its body after a while regardless.
+	if (req.version() >= 11 && ::boost::beast::iequals(req[http::field::expect], "100-continue") &&
+	    _pipeline.empty() && !_writing) {
+		static constexpr std::string_view continue_ = "HTTP/1.1 100 Continue\r\n\r\n";
+		with_stream([&](auto& stream) {
+			asio::async_write(stream, asio::buffer(continue_.data(), continue_.size()),
+			                  [self = Ptr(this)](ec_t ec, std::size_t) {
+				if (ec) {
+					return self->on_read(ec, 0);
+				}
+				self->read_body();
+			});
+		});
+		return;
+	}
+	read_body();
+}
+
+void ServerBase::Session::read_body() {
+	with_stream([&](auto& stream) {
+		http::async_read(stream, *_buffer, *_incoming->parser, [self = Ptr(this)](ec_t ec, std::size_t bytes) {
+			self->on_read(ec, bytes);
+		});
 	});
 }
 
 void ServerBase::Session::on_read(ec_t ec, std::size_t bytes) {
-	if (ec == http::error::end_of_stream) {
-		return do_close();
+	_reading = false;
+	if (_timed_out) {
+		ec = ::boost::beast::error::timeout;
+	}
+	if (ec == http::error::body_limit) {
+		// A chunked body outgrew its limit.
+		_incoming->rejected = true;
+		ec = {};
 	}
 	if (ec) {
-		return fail("on_read", ec);
+		// A TLS client hanging up without close_notify has only ended its last request, as over TCP. A
+		// read already ended by _eof was cut short by the session closing the connection itself.
+		if (ec != http::error::end_of_stream && ec != asio::ssl::error::stream_truncated && !_stopping && !_eof) {
+			warn("on_read", ec, _id);
+		}
+		// Answer whatever is already queued before closing.
+		_eof = true;
+		if (_pipeline.empty()) {
+			do_close();
+		}
+		return;
+	}
+	rearm_quick_ack(_stream.native_handle(), _config.socket, _parent._inet);
+	auto& exchange = *_incoming;
+	auto message = exchange.parser->release();
+	exchange.req.base() = std::move(message.base());
+	exchange.req.body() = std::move(message.body().text);
+	exchange.parser.reset();
+	// The rest of a rejected request's body is never read, so nothing after it can be parsed.
+	if (exchange.rejected || !exchange.req.keep_alive()) {
+		_eof = true;
+	}
+	if (_incoming->timed || _config.queue_target.count() != 0) {
+		_incoming->parsed = std::chrono::steady_clock::now();
+	}
+	_pipeline.push_back(std::move(_incoming));
+	if (_pipeline.size() == 1) {
+		dispatch();
 	}
-	_parent.handle_request(std::move(_request), shared_from_this());
+	if (!_eof && _pipeline.size() < _config.pipeline_limit) {
+		do_read();
+	}
+	// No deadline while the handler runs, unless it is reading ahead or has already started writing.
+	if (!_reading && !_writing) {
+		_shard.disarm(*this);
+	}
+}
+
+void ServerBase::Session::dispatch() {
+	_current = _pipeline.front().get();
+	auto& req = _current->req;
+	auto& res = _current->res;
+	res.version(req.version());
+	res.keep_alive(req.keep_alive());
+	if (_current->timed) {
+		_current->dispatched = std::chrono::steady_clock::now();
+	}
+	if (_current->rejected) {
+		static constexpr std::string_view too_large = "HTTP/1.1 413 Payload Too Large\r\n"
+		                                              "Connection: close\r\n"
+		                                              "Content-Length: 0\r\n\r\n";
+		req.keep_alive(false);
+		return write_canned(too_large);
+	}
+	if ((_parent._metrics || _config.trace_sample != 0) && req.method() == http::verb::get) {
+		auto target = std::string_view(req.target());
+		target = target.substr(0, target.find('?'));
+		std::string report;
+		if (_parent._metrics && target == _config.metrics_path) {
+			_parent.render_metrics(report);
+			return write_report("text/plain; version=0.0.4; charset=utf-8", report);
+		}
+		if (_config.trace_sample != 0 && target == _config.trace_path) {
+			::siesta::render_trace(report);
+			return write_report("application/json", report);
+		}
+	}
+	if (!_parent.admit(*_current)) {
+		return shed();
+	}
+	_parent.handle_request(req, Ptr(this));
+}
+
+// Answers the metrics and trace routes, ahead of admission control so that an overloaded server can
+// still be looked into.
+void ServerBase::Session::write_report(std::string_view content_type, const std::string& report) {
+	if (_config.max_in_flight != 0) {
+		// Released by on_write like any other request's slot.
+		_parent._in_flight.fetch_add(1, std::memory_order_relaxed);
+	}
+	auto& res = _current->res;
+	res.result(http::status::ok);
+	res.set(http::field::content_type, {content_type.data(), content_type.size()});
+	res.body().assign(report.data(), report.size());
+	do_write();
+}
+
+// Records the phases of a sampled exchange that has just been answered.
+void ServerBase::Session::record_trace() {
+	const auto now = std::chrono::steady_clock::now();
+	const auto& x = *_current;
+	const auto names = _parent.endpoint_names();
+	const std::size_t endpoint = !_shed && x.headers != nullptr ? x.headers->endpoint : 0;
+	const auto name = endpoint < names.size() ? names[endpoint] : std::string_view{};
+	::siesta::trace_span("server", "request", x.trace_id, x.read, now, name);
+	::siesta::trace_span("server", "header", x.trace_id, x.read, x.header);
+	::siesta::trace_span("server", "body", x.trace_id, x.header, x.parsed);
+	::siesta::trace_span("server", "queue", x.trace_id, x.parsed, x.dispatched);
+	::siesta::trace_span("server", "handler", x.trace_id, x.dispatched, x.writing);
+	::siesta::trace_span("server", "write", x.trace_id, x.writing, now);
+}
+
+// Records the exchange that has just been answered. Canned responses are counted under endpoint 0.
+void ServerBase::Session::record_metrics(std::size_t bytes) {
+	const auto now = std::chrono::steady_clock::now();
+	const auto ns = [](std::chrono::steady_clock::duration d) {
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+	};
+	const auto& exchange = *_current;
+	std::size_t endpoint = 0;
+	unsigned status;
+	if (_shed) {
+		status = exchange.rejected ? 413 : 503;
+	} else {
+		status = exchange.res.result_int();
+		if (exchange.headers != nullptr) {
+			endpoint = exchange.headers->endpoint;
+		}
+	}
+	_parent._metrics->record({
+		endpoint,
+		ns(exchange.parsed - exchange.read),
+		ns(exchange.writing - exchange.dispatched),
+		ns(now - exchange.writing),
+		bytes,
+		status,
+	});
+}
+
+void ServerBase::Session::shed() {
+	// Serialized once; shedding must cost less than answering.
+	static constexpr std::string_view keep_alive = "HTTP/1.1 503 Service Unavailable\r\n"
+	                                               "Connection: keep-alive\r\n"
+	                                               "Content-Length: 0\r\n"
+	                                               "Retry-After: 1\r\n\r\n";
+	static constexpr std::string_view close = "HTTP/1.1 503 Service Unavailable\r\n"
+	                                          "Connection: close\r\n"
+	                                          "Content-Length: 0\r\n"
+	                                          "Retry-After: 1\r\n\r\n";
+	write_canned(_current->req.keep_alive() ? keep_alive : close);
+}
+
+// Answers the current request with a response serialized ahead of time, leaving its response
+// untouched.
+void ServerBase::Session::write_canned(std::string_view canned) {
+	_shed = true;
+	_writing = true;
+	if (_current->timed) {
+		_current->writing = std::chrono::steady_clock::now();
+	}
+	_shard.arm(*this, _config.write_timeout);
+	with_stream([&](auto& stream) {
+		asio::async_write(stream, asio::buffer(canned.data(), canned.size()),
+		                  [self = Ptr(this)](ec_t ec, std::size_t bytes) { self->on_write(ec, bytes); });
+	});
 }
 
 void ServerBase::Session::on_write(ec_t ec, std::size_t bytes) {
+	_writing = false;
+	if (_timed_out) {
+		ec = ::boost::beast::error::timeout;
+	}
+	if (_parent._metrics && !ec) {
+		record_metrics(bytes + (_body ? _body->sent : 0));
+	}
+	if (_current->trace_id != 0) {
+		record_trace();
+	}
+	_body.reset();
+	// Every response written here is framed, by the rendered head or by beast's serializer, so only
+	// the Connection semantics decide; need_eof() would also count a body whose Content-Length was
+	// rendered rather than set as a field.
+	const bool close = _shed ? !_current->req.keep_alive() : !_current->res.keep_alive();
+	if (!_shed && _config.max_in_flight != 0) {
+		_parent._in_flight.fetch_sub(1, std::memory_order_relaxed);
+	}
+	_current = nullptr;
+	_shed = false;
 	if (ec) {
-		return fail("on_write", ec);
+		if (!_stopping) {
+			warn("on_write", ec, _id);
+		}
+		// The connection cannot carry another response. Its exchange goes back now rather than once
+		// the read side fails too, and so does the rest of the pipeline when the session retires.
+		_eof = true;
+		_shard.disarm(*this);
+		recycle(std::move(_pipeline.front()));
+		_pipeline.pop_front();
+		return do_close();
 	}
-	do_read();
+	if (_reading) {
+		_shard.arm(*this, _config.read_timeout);
+	} else {
+		_shard.disarm(*this);
+	}
+	recycle(std::move(_pipeline.front()));
+	_pipeline.pop_front();
+	if (close) {
+		return do_close();
+	}
+	if (!_pipeline.empty()) {
+		dispatch();
+	} else if (_eof) {
+		return do_close();
+	} else if (_waiting) {
+		// The read-ahead found nothing to parse; idle until the next request arrives.
+		release_idle();
+	}
+	if (!_reading && !_eof && _pipeline.size() < _config.pipeline_limit) {
+		do_read();
+	}
+}
+
+void ServerBase::Session::on_deadline(uint32_t epoch) {
+	// The deadline was re-armed or disarmed on the session's strand after the wheel let it go.
+	if (epoch != _deadline_epoch) {
+		return;
+	}
+	_timed_out = true;
+	if (_parent._metrics) {
+		_parent._metrics->count_timeout();
+	}
+	do_close();
 }
 
 void ServerBase::Session::do_close() {
 	ec_t ec;
-	_stream.close();
+	_stream.close(ec);
 }
 
 namespace __detail {
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: Apache-2.0
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <siesta/beast/socket_options.hpp>
+#include <sys/socket.h>
+
+namespace siesta::beast {
+
+namespace {
+
+void set(int fd, int level, int name, int value) noexcept {
+	::setsockopt(fd, level, name, &value, sizeof(value));
+}
+
+void apply_buffers(int fd, const SocketOptions& options) noexcept {
+	if (options.receive_buffer > 0) {
+		set(fd, SOL_SOCKET, SO_RCVBUF, options.receive_buffer);
+	}
+	if (options.send_buffer > 0) {
+		set(fd, SOL_SOCKET, SO_SNDBUF, options.send_buffer);
+	}
+}
+
+void apply_connection(int fd, const SocketOptions& options, bool inet) noexcept {
+	if (!inet) {
+		return;
+	}
+	if (options.no_delay) {
+		set(fd, IPPROTO_TCP, TCP_NODELAY, 1);
+	}
+	rearm_quick_ack(fd, options, inet);
+#ifdef SO_BUSY_POLL
+	if (options.busy_poll > 0) {
+		set(fd, SOL_SOCKET, SO_BUSY_POLL, options.busy_poll);
+	}
+#endif
+}
+
+} // namespace
+
+void apply_listener_options(int fd, const SocketOptions& options, bool inet) noexcept {
+	apply_buffers(fd, options);
+	if (!inet) {
+		return;
+	}
+#ifdef TCP_DEFER_ACCEPT
+	if (options.defer_accept > 0) {
+		set(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, options.defer_accept);
+	}
+#endif
+#ifdef TCP_FASTOPEN
+	if (options.fast_open > 0) {
+		set(fd, IPPROTO_TCP, TCP_FASTOPEN, options.fast_open);
+	}
+#endif
+}
+
+void apply_accepted_options(int fd, const SocketOptions& options, bool inet) noexcept {
+	apply_connection(fd, options, inet);
+}
+
+void apply_connect_options(int fd, const SocketOptions& options, bool inet) noexcept {
+	apply_buffers(fd, options);
+	apply_connection(fd, options, inet);
+#ifdef TCP_FASTOPEN_CONNECT
+	if (inet && options.fast_open > 0) {
+		set(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, 1);
+	}
+#endif
+}
+
+void rearm_quick_ack(int fd, const SocketOptions& options, bool inet) noexcept {
+#ifdef TCP_QUICKACK
+	if (inet && options.quick_ack) {
+		set(fd, IPPROTO_TCP, TCP_QUICKACK, 1);
+	}
+#endif
+}
+
+} // namespace siesta::beast
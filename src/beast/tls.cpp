@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: Apache-2.0
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+#include <siesta/beast/tls.hpp>
+
+namespace asio = ::boost::asio;
+
+namespace siesta::beast {
+
+namespace {
+
+// The ticket keys of a context, freed with it.
+int ticket_keys_index() {
+	static const int index = SSL_CTX_get_ex_new_index(
+		0, nullptr, nullptr, nullptr, [](void*, void* keys, CRYPTO_EX_DATA*, int, long, void*) {
+			delete static_cast<std::vector<tls_ticket_key>*>(keys);
+		});
+	return index;
+}
+
+// Encrypts a new ticket under the first key, or finds the key a returning ticket was encrypted
+// under: 1 if found, 2 if found but old enough to be renewed, 0 if unknown, -1 on failure.
+int ticket_key_callback(SSL* ssl, unsigned char* name, unsigned char* iv, EVP_CIPHER_CTX* cipher,
+                        EVP_MAC_CTX* mac, int encrypt) {
+	const auto* keys = static_cast<const std::vector<tls_ticket_key>*>(
+		SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), ticket_keys_index()));
+	constexpr std::size_t name_size = 16;
+	constexpr std::size_t iv_size = 16;
+	auto key = keys->begin();
+	if (encrypt) {
+		if (RAND_bytes(iv, iv_size) != 1) {
+			return -1;
+		}
+		std::memcpy(name, key->data(), name_size);
+	} else {
+		key = std::find_if(keys->begin(), keys->end(), [name](const tls_ticket_key& k) {
+			return std::memcmp(name, k.data(), name_size) == 0;
+		});
+		if (key == keys->end()) {
+			return 0;
+		}
+	}
+	const auto* secret = key->data() + name_size;
+	const auto* aes = secret + 32;
+	OSSL_PARAM params[] = {
+		OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, const_cast<unsigned char*>(secret), 32),
+		OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, const_cast<char*>("SHA256"), 0),
+		OSSL_PARAM_construct_end(),
+	};
+	if (EVP_MAC_CTX_set_params(mac, params) != 1) {
+		return -1;
+	}
+	const int ready = encrypt ? EVP_EncryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr, aes, iv)
+	                          : EVP_DecryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr, aes, iv);
+	if (ready != 1) {
+		return -1;
+	}
+	return key == keys->begin() ? 1 : 2;
+}
+
+} // namespace
+
+void configure_server_tls(asio::ssl::context& ctx) {
+	ctx.set_options(asio::ssl::context::default_workarounds | asio::ssl::context::no_sslv2 |
+	                asio::ssl::context::no_sslv3 | asio::ssl::context::no_tlsv1 | asio::ssl::context::no_tlsv1_1 |
+	                asio::ssl::context::single_dh_use);
+	auto* native = ctx.native_handle();
+	// Tickets cover clients that keep their session; the cache covers TLS 1.2 clients resuming by ID.
+	SSL_CTX_clear_options(native, SSL_OP_NO_TICKET);
+	SSL_CTX_set_session_cache_mode(native, SSL_SESS_CACHE_SERVER);
+	static constexpr unsigned char session_id_context[] = "siesta";
+	SSL_CTX_set_session_id_context(native, session_id_context, sizeof(session_id_context) - 1);
+}
+
+void use_ticket_keys(asio::ssl::context& ctx, std::vector<tls_ticket_key> keys) {
+	if (keys.empty()) {
+		return;
+	}
+	auto* native = ctx.native_handle();
+	const int index = ticket_keys_index();
+	delete static_cast<std::vector<tls_ticket_key>*>(SSL_CTX_get_ex_data(native, index));
+	SSL_CTX_set_ex_data(native, index, new std::vector<tls_ticket_key>(std::move(keys)));
+	SSL_CTX_set_tlsext_ticket_key_evp_cb(native, ticket_key_callback);
+}
+
+std::optional<tls_ticket_key> load_ticket_key(const std::string& file) {
+	std::unique_ptr<std::FILE, decltype(&std::fclose)> in(std::fopen(file.c_str(), "rb"), std::fclose);
+	if (!in) {
+		return std::nullopt;
+	}
+	tls_ticket_key key;
+	// One byte more than a key, to tell a longer file apart.
+	std::array<unsigned char, std::tuple_size_v<tls_ticket_key> + 1> bytes;
+	if (std::fread(bytes.data(), 1, bytes.size(), in.get()) != key.size()) {
+		return std::nullopt;
+	}
+	std::copy_n(bytes.begin(), key.size(), key.begin());
+	return key;
+}
+
+asio::ssl::context make_server_tls_context(const std::string& cert_chain_file, const std::string& key_file) {
+	asio::ssl::context ctx(asio::ssl::context::tls_server);
+	configure_server_tls(ctx);
+	ctx.use_certificate_chain_file(cert_chain_file);
+	ctx.use_private_key_file(key_file, asio::ssl::context::pem);
+	return ctx;
+}
+
+asio::ssl::context make_client_tls_context() {
+	asio::ssl::context ctx(asio::ssl::context::tls_client);
+	ctx.set_options(asio::ssl::context::default_workarounds | asio::ssl::context::no_sslv2 |
+	                asio::ssl::context::no_sslv3 | asio::ssl::context::no_tlsv1 | asio::ssl::context::no_tlsv1_1);
+	ctx.set_default_verify_paths();
+	ctx.set_verify_mode(asio::ssl::verify_peer);
+	return ctx;
+}
+
+} // namespace siesta::beast
@@ -0,0 +1,193 @@
+// SPDX-License-Identifier: Apache-2.0
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <climits>
+#include <siesta/compress.hpp>
+#include <zlib.h>
+
+namespace siesta {
+
+namespace {
+
+// zlib's windowBits: 15 for the zlib wrapper HTTP calls "deflate", plus 16 for a gzip wrapper.
+int window_bits(coding c) { return c == coding::gzip ? 15 + 16 : 15; }
+
+bool iequals(std::string_view a, std::string_view b) {
+	return std::ranges::equal(a, b, [](char x, char y) {
+		return (x | 0x20) == (y | 0x20);
+	});
+}
+
+std::string_view trim(std::string_view sv) {
+	while (!sv.empty() && (sv.front() == ' ' || sv.front() == '\t')) {
+		sv.remove_prefix(1);
+	}
+	while (!sv.empty() && (sv.back() == ' ' || sv.back() == '\t')) {
+		sv.remove_suffix(1);
+	}
+	return sv;
+}
+
+// One compression stream per thread and coding, re-initialised only when the level changes.
+struct Deflater {
+	z_stream zs{};
+	int level{0};
+	bool ready{false};
+
+	~Deflater() {
+		if (ready) {
+			deflateEnd(&zs);
+		}
+	}
+
+	z_stream* get(coding c, int lvl) {
+		if (ready && level == lvl) {
+			return deflateReset(&zs) == Z_OK ? &zs : nullptr;
+		}
+		if (ready) {
+			deflateEnd(&zs);
+		}
+		zs = z_stream{};
+		ready = deflateInit2(&zs, lvl, Z_DEFLATED, window_bits(c), 8, Z_DEFAULT_STRATEGY) == Z_OK;
+		level = lvl;
+		return ready ? &zs : nullptr;
+	}
+};
+
+struct Inflater {
+	z_stream zs{};
+	bool ready{false};
+
+	~Inflater() {
+		if (ready) {
+			inflateEnd(&zs);
+		}
+	}
+
+	z_stream* get(coding c) {
+		if (ready) {
+			return inflateReset(&zs) == Z_OK ? &zs : nullptr;
+		}
+		ready = inflateInit2(&zs, window_bits(c)) == Z_OK;
+		return ready ? &zs : nullptr;
+	}
+};
+
+thread_local std::array<Deflater, 2> deflaters;
+thread_local std::array<Inflater, 2> inflaters;
+
+std::size_t slot(coding c) { return c == coding::gzip ? 0 : 1; }
+
+} // namespace
+
+coding negotiate_coding(std::string_view accept_encoding) noexcept {
+	// -1 while a coding is not named at all.
+	double gzip = -1, deflate = -1, any = -1;
+	while (!accept_encoding.empty()) {
+		const auto comma = accept_encoding.find(',');
+		auto item = accept_encoding.substr(0, comma);
+		accept_encoding.remove_prefix(comma == std::string_view::npos ? accept_encoding.size() : comma + 1);
+
+		double q = 1;
+		const auto semi = item.find(';');
+		if (semi != std::string_view::npos) {
+			auto param = trim(item.substr(semi + 1));
+			if (param.size() > 2 && (param[0] | 0x20) == 'q' && param[1] == '=') {
+				std::from_chars(param.data() + 2, param.data() + param.size(), q);
+			}
+			item = item.substr(0, semi);
+		}
+		item = trim(item);
+		if (iequals(item, "gzip") || iequals(item, "x-gzip")) {
+			gzip = q;
+		} else if (iequals(item, "deflate")) {
+			deflate = q;
+		} else if (item == "*") {
+			any = q;
+		}
+	}
+	// A wildcard only speaks for codings not named on their own.
+	gzip = gzip < 0 ? any : gzip;
+	deflate = deflate < 0 ? any : deflate;
+	if (gzip > 0 && gzip >= deflate) {
+		return coding::gzip;
+	}
+	return deflate > 0 ? coding::deflate : coding::identity;
+}
+
+coding parse_coding(std::string_view content_encoding) noexcept {
+	content_encoding = trim(content_encoding);
+	if (iequals(content_encoding, "gzip") || iequals(content_encoding, "x-gzip")) {
+		return coding::gzip;
+	}
+	return iequals(content_encoding, "deflate") ? coding::deflate : coding::identity;
+}
+
+std::string_view coding_name(coding c) noexcept {
+	switch (c) {
+	case coding::gzip:
+		return "gzip";
+	case coding::deflate:
+		return "deflate";
+	default:
+		return "identity";
+	}
+}
+
+std::size_t compress_bound(coding, std::size_t size) noexcept {
+	// compressBound() covers the zlib wrapper; a gzip wrapper is 12 bytes longer.
+	return compressBound(static_cast<uLong>(size)) + 12;
+}
+
+std::size_t compress(coding c, int level, std::string_view in, char* out) noexcept {
+	if (c == coding::identity || in.size() > UINT_MAX) {
+		return 0;
+	}
+	auto* zs = deflaters[slot(c)].get(c, level);
+	if (zs == nullptr) {
+		return 0;
+	}
+	const auto bound = compress_bound(c, in.size());
+	zs->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+	zs->avail_in = static_cast<uInt>(in.size());
+	zs->next_out = reinterpret_cast<Bytef*>(out);
+	zs->avail_out = static_cast<uInt>(std::min<std::size_t>(bound, UINT_MAX));
+	if (deflate(zs, Z_FINISH) != Z_STREAM_END) {
+		return 0;
+	}
+	return zs->total_out;
+}
+
+bool decompress(coding c, std::string_view in, std::string& out, std::size_t limit) {
+	if (c == coding::identity || in.size() > UINT_MAX) {
+		return false;
+	}
+	auto* zs = inflaters[slot(c)].get(c);
+	if (zs == nullptr) {
+		return false;
+	}
+	const auto start = out.size();
+	const auto step = std::clamp<std::size_t>(in.size() * 4, 4096, 1 << 20);
+	zs->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+	zs->avail_in = static_cast<uInt>(in.size());
+	int rc = Z_OK;
+	while (rc == Z_OK) {
+		const auto size = out.size();
+		out.resize(size + step);
+		zs->next_out = reinterpret_cast<Bytef*>(out.data() + size);
+		zs->avail_out = static_cast<uInt>(step);
+		rc = inflate(zs, Z_NO_FLUSH);
+		out.resize(out.size() - zs->avail_out);
+		if (out.size() - start > limit) {
+			rc = Z_DATA_ERROR;
+		}
+	}
+	if (rc != Z_STREAM_END) {
+		out.resize(start);
+		return false;
+	}
+	return true;
+}
+
+} // namespace siesta
@@ -0,0 +1,388 @@
+// SPDX-License-Identifier: Apache-2.0
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <siesta/log.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace siesta {
+
+namespace {
+
+constexpr std::size_t ring_size = 512; // records per thread
+constexpr std::size_t text_size = 95;
+
+struct log_record {
+	int64_t time_ns; // since the system_clock epoch
+	const char* facility;
+	uint64_t session;
+	const ::boost::system::error_category* category; // null unless an error code was logged
+	int code;
+	log_level level;
+	uint8_t size;
+	std::array<char, text_size> text;
+};
+
+// Single producer, the owning thread; single consumer, whoever holds the drain mutex.
+struct log_ring {
+	std::array<log_record, ring_size> records;
+	alignas(64) std::atomic<uint64_t> head{0};
+	alignas(64) std::atomic<uint64_t> tail{0};
+	std::atomic<uint64_t> dropped{0}; // records that found the ring full; only the owner writes it
+	uint64_t reported{0};             // dropped records already logged; only the consumer uses it
+	std::atomic<bool> owned{false};
+};
+
+struct logger {
+	std::atomic<log_level> level{log_level::info};
+	std::atomic<uint32_t> rate_limit{100};
+	// Rings outlive their threads until drained; a new thread takes over the ring of one that exited.
+	std::mutex rings_mutex;
+	std::vector<std::unique_ptr<log_ring>> rings;
+	// Records of threads that could not get a ring, and how many of them have been reported.
+	std::atomic<uint64_t> ringless{0};
+	uint64_t ringless_reported{0};
+	// Guards the sink and the consumer side of every ring.
+	std::mutex drain_mutex;
+	std::condition_variable wake;
+	std::function<void(std::string_view)> sink;
+	std::chrono::milliseconds interval{50};
+	bool stopping{false};
+	std::once_flag started;
+	std::thread drainer;
+
+	// Drains what is left and stops the drain thread. Records logged afterwards stay in their rings.
+	void stop() {
+		{
+			std::lock_guard lock(drain_mutex);
+			stopping = true;
+		}
+		wake.notify_one();
+		if (drainer.joinable()) {
+			drainer.join();
+		}
+	}
+
+	// Without a drain thread, records wait for flush_log().
+	void start() noexcept {
+		try {
+			std::call_once(started, [this] { drainer = std::thread([this] { run(); }); });
+		} catch (...) {
+		}
+	}
+
+	void run() {
+		std::unique_lock lock(drain_mutex);
+		while (!stopping) {
+			wake.wait_for(lock, interval);
+			drain_quietly();
+		}
+		drain_quietly();
+	}
+
+	// A round that fails to allocate loses its lines rather than the process.
+	void drain_quietly() noexcept {
+		try {
+			drain();
+		} catch (...) {
+		}
+	}
+
+	void drain();
+};
+
+// Never destroyed, so that threads still running during static destruction, and their ring_owner
+// on exit, never touch a logger that is gone.
+logger& instance() {
+	static auto* l = new logger;
+	return *l;
+}
+
+// Stops the drain thread at exit, after writing out what was logged until then.
+struct drain_stopper {
+	~drain_stopper() { instance().stop(); }
+} stopper;
+
+struct ring_owner {
+	log_ring* ring{nullptr};
+
+	~ring_owner() {
+		if (ring != nullptr) {
+			ring->owned.store(false, std::memory_order_release);
+		}
+	}
+};
+thread_local ring_owner local;
+
+// Null if the thread has no ring and none can be allocated or registered.
+log_ring* local_ring() noexcept {
+	if (local.ring != nullptr) {
+		return local.ring;
+	}
+	auto& l = instance();
+	try {
+		std::lock_guard lock(l.rings_mutex);
+		for (auto& ring : l.rings) {
+			if (!ring->owned.load(std::memory_order_acquire)) {
+				local.ring = ring.get();
+				break;
+			}
+		}
+		if (local.ring == nullptr) {
+			local.ring = l.rings.emplace_back(std::make_unique<log_ring>()).get();
+		}
+		local.ring->owned.store(true, std::memory_order_relaxed);
+	} catch (...) {
+		return nullptr;
+	}
+	l.start();
+	return local.ring;
+}
+
+void push(const log_record& record) noexcept {
+	auto* ring_ptr = local_ring();
+	if (ring_ptr == nullptr) {
+		instance().ringless.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	auto& ring = *ring_ptr;
+	const auto head = ring.head.load(std::memory_order_relaxed);
+	if (head - ring.tail.load(std::memory_order_acquire) >= ring_size) {
+		ring.dropped.store(ring.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return;
+	}
+	ring.records[head % ring_size] = record;
+	ring.head.store(head + 1, std::memory_order_release);
+}
+
+// Records a facility has logged in the current second on this thread. One slot per facility hash;
+// facilities sharing a slot share a budget until one of them moves on to a new second.
+struct rate_slot {
+	const char* facility{nullptr};
+	int64_t second{0};
+	uint32_t count{0};
+	uint32_t suppressed{0};
+};
+thread_local std::array<rate_slot, 16> rates;
+
+log_record make_record(log_level level, const char* facility, uint64_t session, int64_t time_ns) {
+	log_record record;
+	record.time_ns = time_ns;
+	record.facility = facility;
+	record.session = session;
+	record.category = nullptr;
+	record.code = 0;
+	record.level = level;
+	record.size = 0;
+	return record;
+}
+
+void set_text(log_record& record, std::string_view text) {
+	record.size = static_cast<uint8_t>(std::min(text.size(), text_size));
+	std::copy_n(text.data(), record.size, record.text.data());
+}
+
+// False if the facility has used up this second's budget on this thread. Reports what a past second
+// suppressed once the facility logs again.
+bool admit(const char* facility, int64_t time_ns) {
+	const auto limit = instance().rate_limit.load(std::memory_order_relaxed);
+	if (limit == 0) {
+		return true;
+	}
+	const auto second = time_ns / 1'000'000'000;
+	auto& slot = rates[(reinterpret_cast<std::uintptr_t>(facility) >> 4) % rates.size()];
+	if (slot.facility != facility || slot.second != second) {
+		if (slot.suppressed != 0) {
+			auto note = make_record(log_level::warning, slot.facility, log_no_session, time_ns);
+			std::array<char, 48> text;
+			auto end = std::to_chars(text.data(), text.data() + text.size(), slot.suppressed).ptr;
+			constexpr std::string_view suffix = " records suppressed by the rate limit";
+			end = std::copy(suffix.begin(), suffix.end(), end);
+			set_text(note, {text.data(), static_cast<std::size_t>(end - text.data())});
+			push(note);
+		}
+		slot = {facility, second, 0, 0};
+	}
+	if (++slot.count > limit) {
+		++slot.suppressed;
+		return false;
+	}
+	return true;
+}
+
+int64_t wall_clock_ns() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch())
+	    .count();
+}
+
+std::string_view level_name(log_level level) {
+	switch (level) {
+	case log_level::debug:
+		return "debug";
+	case log_level::info:
+		return "info";
+	case log_level::warning:
+		return "warning";
+	default:
+		return "error";
+	}
+}
+
+template <typename T>
+void append_number(std::string& out, T value) {
+	std::array<char, 24> digits;
+	out.append(digits.data(), std::to_chars(digits.data(), digits.data() + digits.size(), value).ptr);
+}
+
+void append_quoted(std::string& out, std::string_view text) {
+	out.push_back('"');
+	for (const char c : text) {
+		if (c == '"' || c == '\\') {
+			out.push_back('\\');
+			out.push_back(c);
+		} else if (c == '\n') {
+			out.append("\\n");
+		} else {
+			out.push_back(c);
+		}
+	}
+	out.push_back('"');
+}
+
+void format(std::string& out, const log_record& record) {
+	const std::time_t seconds = record.time_ns / 1'000'000'000;
+	std::tm tm;
+	gmtime_r(&seconds, &tm);
+	std::array<char, 32> stamp;
+	const auto size = std::strftime(stamp.data(), stamp.size(), "%Y-%m-%dT%H:%M:%S", &tm);
+	out.append(stamp.data(), size);
+	const auto micros = static_cast<unsigned>(record.time_ns % 1'000'000'000 / 1000);
+	std::snprintf(stamp.data(), stamp.size(), ".%06uZ ", micros);
+	out.append(stamp.data());
+	out.append(level_name(record.level)).append(" ").append(record.facility);
+	if (record.session != log_no_session) {
+		out.append(" session=");
+		append_number(out, record.session);
+	}
+	if (record.category != nullptr) {
+		std::string error = record.category->name();
+		error.push_back(':');
+		append_number(error, record.code);
+		error.push_back(' ');
+		error.append(record.category->message(record.code));
+		out.append(" error=");
+		append_quoted(out, error);
+	}
+	if (record.size != 0) {
+		out.append(" msg=");
+		append_quoted(out, {record.text.data(), record.size});
+	}
+	out.push_back('\n');
+}
+
+void logger::drain() {
+	std::vector<log_ring*> snapshot;
+	{
+		std::lock_guard lock(rings_mutex);
+		for (auto& ring : rings) {
+			snapshot.push_back(ring.get());
+		}
+	}
+	std::string lines;
+	for (auto* ring : snapshot) {
+		auto tail = ring->tail.load(std::memory_order_relaxed);
+		const auto head = ring->head.load(std::memory_order_acquire);
+		for (; tail != head; ++tail) {
+			format(lines, ring->records[tail % ring_size]);
+		}
+		ring->tail.store(tail, std::memory_order_release);
+		const auto dropped = ring->dropped.load(std::memory_order_relaxed);
+		if (dropped != ring->reported) {
+			auto note = make_record(log_level::warning, "log", log_no_session, wall_clock_ns());
+			std::array<char, 48> text;
+			auto end = std::to_chars(text.data(), text.data() + text.size(), dropped - ring->reported).ptr;
+			constexpr std::string_view suffix = " records dropped on a full ring";
+			end = std::copy(suffix.begin(), suffix.end(), end);
+			set_text(note, {text.data(), static_cast<std::size_t>(end - text.data())});
+			format(lines, note);
+			ring->reported = dropped;
+		}
+	}
+	const auto lost = ringless.load(std::memory_order_relaxed);
+	if (lost != ringless_reported) {
+		auto note = make_record(log_level::warning, "log", log_no_session, wall_clock_ns());
+		std::array<char, 48> text;
+		auto end = std::to_chars(text.data(), text.data() + text.size(), lost - ringless_reported).ptr;
+		constexpr std::string_view suffix = " records dropped without a ring";
+		end = std::copy(suffix.begin(), suffix.end(), end);
+		set_text(note, {text.data(), static_cast<std::size_t>(end - text.data())});
+		format(lines, note);
+		ringless_reported = lost;
+	}
+	if (lines.empty()) {
+		return;
+	}
+	if (sink) {
+		sink(lines);
+	} else {
+		std::fwrite(lines.data(), 1, lines.size(), stderr);
+		std::fflush(stderr);
+	}
+}
+
+} // namespace
+
+void configure_log(log_config config) {
+	auto& l = instance();
+	l.level.store(config.level, std::memory_order_relaxed);
+	l.rate_limit.store(config.rate_limit, std::memory_order_relaxed);
+	std::lock_guard lock(l.drain_mutex);
+	l.sink = std::move(config.sink);
+	l.interval = std::max(config.drain_interval, std::chrono::milliseconds{1});
+}
+
+bool log_enabled(log_level level) noexcept { return level >= instance().level.load(std::memory_order_relaxed); }
+
+void log_message(log_level level, const char* facility, std::string_view text, uint64_t session) noexcept {
+	if (!log_enabled(level)) {
+		return;
+	}
+	const auto now = wall_clock_ns();
+	if (!admit(facility, now)) {
+		return;
+	}
+	auto record = make_record(level, facility, session, now);
+	set_text(record, text);
+	push(record);
+}
+
+void log_error(log_level level, const char* facility, const ::boost::system::error_code& ec,
+               uint64_t session) noexcept {
+	if (!log_enabled(level)) {
+		return;
+	}
+	const auto now = wall_clock_ns();
+	if (!admit(facility, now)) {
+		return;
+	}
+	auto record = make_record(level, facility, session, now);
+	record.category = &ec.category();
+	record.code = ec.value();
+	push(record);
+}
+
+void flush_log() {
+	auto& l = instance();
+	std::lock_guard lock(l.drain_mutex);
+	l.drain();
+}
+
+} // namespace siesta
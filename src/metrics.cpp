@@ -0,0 +1,265 @@
+// SPDX-License-Identifier: Apache-2.0
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <siesta/metrics.hpp>
+#include <thread>
+
+namespace siesta {
+
+struct request_metrics::endpoint_stats {
+	histogram read_ns;
+	histogram handler_ns;
+	histogram write_ns;
+	histogram bytes;
+	std::array<std::atomic<uint64_t>, 5> responses{};
+};
+
+// One thread's counts. Endpoint stats are allocated the first time the thread records for them and
+// published with a release store, so collect() never sees one half-constructed.
+struct request_metrics::thread_block {
+	std::thread::id owner;
+	std::unique_ptr<std::atomic<endpoint_stats*>[]> endpoints;
+	std::size_t size;
+	std::atomic<uint64_t> connections{0};
+	std::atomic<uint64_t> timeouts{0};
+
+	thread_block(std::thread::id owner, std::size_t size)
+		: owner(owner)
+		, endpoints(std::make_unique<std::atomic<endpoint_stats*>[]>(size))
+		, size(size) {}
+
+	~thread_block() {
+		for (std::size_t i = 0; i < size; ++i) {
+			delete endpoints[i].load(std::memory_order_relaxed);
+		}
+	}
+
+	endpoint_stats& at(std::size_t index) {
+		auto* stats = endpoints[index].load(std::memory_order_relaxed);
+		if (stats == nullptr) {
+			stats = new endpoint_stats;
+			endpoints[index].store(stats, std::memory_order_release);
+		}
+		return *stats;
+	}
+};
+
+namespace {
+
+std::atomic<uint64_t> next_id{1};
+
+// The block the calling thread last recorded into, and the instance it belongs to. Threads serve
+// one server almost always, so one entry is enough.
+struct cached_block {
+	uint64_t id{0};
+	void* block{nullptr};
+};
+thread_local cached_block cached;
+
+void append_number(std::string& out, uint64_t value) {
+	std::array<char, 24> digits;
+	out.append(digits.data(), std::to_chars(digits.data(), digits.data() + digits.size(), value).ptr);
+}
+
+void append_number(std::string& out, double value) {
+	std::array<char, 32> digits;
+	out.append(digits.data(), std::to_chars(digits.data(), digits.data() + digits.size(), value).ptr);
+}
+
+void append_labels(std::string& out, std::string_view endpoint) {
+	out.append("{endpoint=\"").append(endpoint).append("\"");
+}
+
+void append_header(std::string& out, std::string_view name, std::string_view type, std::string_view help) {
+	out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+	out.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+}
+
+// Buckets end below powers of two 2^k, k from `first` to `last` in steps of `step`. A histogram
+// bucket starts at every power of two, so they are labelled with the largest value they count,
+// 2^k - 1, as Prometheus bounds are inclusive. Values are divided by `divisor` on the way out:
+// nanoseconds are exported as seconds.
+struct histogram_family {
+	std::string_view name;
+	std::string_view help;
+	histogram_snapshot request_metrics::endpoint_snapshot::*member;
+	unsigned first;
+	unsigned last;
+	unsigned step;
+	double divisor;
+};
+
+void render_histogram(std::string& out, const histogram_family& family, const request_metrics::snapshot& snapshot,
+                      std::span<const std::string_view> names) {
+	append_header(out, family.name, "histogram", family.help);
+	for (std::size_t i = 0; i < snapshot.endpoints.size(); ++i) {
+		const auto& h = snapshot.endpoints[i].*family.member;
+		if (h.count == 0) {
+			continue;
+		}
+		for (unsigned k = family.first; k <= family.last; k += family.step) {
+			out.append(family.name).append("_bucket");
+			append_labels(out, names[i]);
+			out.append(",le=\"");
+			append_number(out, static_cast<double>((uint64_t(1) << k) - 1) / family.divisor);
+			out.append("\"} ");
+			append_number(out, h.count_below(uint64_t(1) << k));
+			out.push_back('\n');
+		}
+		out.append(family.name).append("_bucket");
+		append_labels(out, names[i]);
+		out.append(",le=\"+Inf\"} ");
+		append_number(out, h.count);
+		out.push_back('\n');
+		out.append(family.name).append("_sum");
+		append_labels(out, names[i]);
+		out.append("} ");
+		append_number(out, static_cast<double>(h.sum) / family.divisor);
+		out.push_back('\n');
+		out.append(family.name).append("_count");
+		append_labels(out, names[i]);
+		out.append("} ");
+		append_number(out, h.count);
+		out.push_back('\n');
+	}
+}
+
+} // namespace
+
+void histogram_snapshot::add(const histogram& h) noexcept {
+	for (std::size_t i = 0; i < histogram::buckets; ++i) {
+		const auto n = h.count(i);
+		counts[i] += n;
+		count += n;
+	}
+	sum += h.sum();
+}
+
+uint64_t histogram_snapshot::quantile(double q) const noexcept {
+	if (count == 0) {
+		return 0;
+	}
+	const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(std::clamp(q, 0.0, 1.0) * count)));
+	uint64_t seen = 0;
+	for (std::size_t i = 0; i < histogram::buckets; ++i) {
+		seen += counts[i];
+		if (seen >= rank) {
+			return histogram::lower_bound(i);
+		}
+	}
+	return histogram::lower_bound(histogram::buckets - 1);
+}
+
+uint64_t histogram_snapshot::count_below(uint64_t limit) const noexcept {
+	uint64_t below = 0;
+	for (std::size_t i = 0; i < histogram::bucket(limit); ++i) {
+		below += counts[i];
+	}
+	return below;
+}
+
+request_metrics::request_metrics(std::size_t endpoints)
+	: _id(next_id.fetch_add(1, std::memory_order_relaxed))
+	, _endpoints(std::max<std::size_t>(endpoints, 1)) {}
+
+request_metrics::~request_metrics() = default;
+
+request_metrics::thread_block& request_metrics::local() {
+	if (cached.id == _id) {
+		return *static_cast<thread_block*>(cached.block);
+	}
+	const auto self = std::this_thread::get_id();
+	std::lock_guard lock(_mutex);
+	auto it = std::find_if(_blocks.begin(), _blocks.end(), [&](const auto& block) {
+		return block->owner == self;
+	});
+	auto& block = it != _blocks.end() ? **it : *_blocks.emplace_back(std::make_unique<thread_block>(self, _endpoints));
+	cached = {_id, &block};
+	return block;
+}
+
+void request_metrics::record(const sample& s) {
+	auto& stats = local().at(s.endpoint < _endpoints ? s.endpoint : 0);
+	stats.read_ns.record(s.read_ns);
+	stats.handler_ns.record(s.handler_ns);
+	stats.write_ns.record(s.write_ns);
+	stats.bytes.record(s.bytes);
+	const auto cls = std::clamp<unsigned>(s.status / 100, 1, 5) - 1;
+	histogram::bump(stats.responses[cls], 1);
+}
+
+void request_metrics::count_connection() { histogram::bump(local().connections, 1); }
+
+void request_metrics::count_timeout() { histogram::bump(local().timeouts, 1); }
+
+request_metrics::snapshot request_metrics::collect() const {
+	snapshot out;
+	out.endpoints.resize(_endpoints);
+	std::lock_guard lock(_mutex);
+	for (const auto& block : _blocks) {
+		out.connections += block->connections.load(std::memory_order_relaxed);
+		out.timeouts += block->timeouts.load(std::memory_order_relaxed);
+		for (std::size_t i = 0; i < _endpoints; ++i) {
+			const auto* stats = block->endpoints[i].load(std::memory_order_acquire);
+			if (stats == nullptr) {
+				continue;
+			}
+			auto& e = out.endpoints[i];
+			e.read_ns.add(stats->read_ns);
+			e.handler_ns.add(stats->handler_ns);
+			e.write_ns.add(stats->write_ns);
+			e.bytes.add(stats->bytes);
+			for (std::size_t c = 0; c < e.responses.size(); ++c) {
+				e.responses[c] += stats->responses[c].load(std::memory_order_relaxed);
+			}
+		}
+	}
+	return out;
+}
+
+void render_prometheus(std::string& out, const request_metrics::snapshot& snapshot,
+                       std::span<const std::string_view> names) {
+	using endpoint = request_metrics::endpoint_snapshot;
+	// Time buckets run from about a microsecond to 17 seconds, byte buckets from 64 bytes to 1 GiB.
+	static constexpr std::array<histogram_family, 4> families{{
+		{"siesta_request_read_seconds", "Time from the first read of a request until it was parsed.",
+		 &endpoint::read_ns, 10, 34, 1, 1e9},
+		{"siesta_request_handler_seconds", "Time from dispatching a request until its response was written.",
+		 &endpoint::handler_ns, 10, 34, 1, 1e9},
+		{"siesta_response_write_seconds", "Time spent writing a response.", &endpoint::write_ns, 10, 34, 1, 1e9},
+		{"siesta_response_bytes", "Response bytes written.", &endpoint::bytes, 6, 30, 2, 1},
+	}};
+	for (const auto& family : families) {
+		render_histogram(out, family, snapshot, names);
+	}
+
+	append_header(out, "siesta_responses_total", "counter", "Responses written, by status class.");
+	static constexpr std::array<std::string_view, 5> classes{"1xx", "2xx", "3xx", "4xx", "5xx"};
+	for (std::size_t i = 0; i < snapshot.endpoints.size(); ++i) {
+		const auto& responses = snapshot.endpoints[i].responses;
+		for (std::size_t c = 0; c < classes.size(); ++c) {
+			if (responses[c] == 0) {
+				continue;
+			}
+			out.append("siesta_responses_total");
+			append_labels(out, names[i]);
+			out.append(",code=\"").append(classes[c]).append("\"} ");
+			append_number(out, responses[c]);
+			out.push_back('\n');
+		}
+	}
+	render_prometheus_value(out, "siesta_connections_total", "counter", "Connections accepted.", snapshot.connections);
+	render_prometheus_value(out, "siesta_timeouts_total", "counter", "Connections closed by a read or write deadline.",
+	                        snapshot.timeouts);
+}
+
+void render_prometheus_value(std::string& out, std::string_view name, std::string_view type, std::string_view help,
+                             uint64_t value) {
+	append_header(out, name, type, help);
+	out.append(name).append(" ");
+	append_number(out, value);
+	out.push_back('\n');
+}
+
+} // namespace siesta
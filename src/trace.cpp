@@ -0,0 +1,223 @@
+// SPDX-License-Identifier: Apache-2.0
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <siesta/trace.hpp>
+#include <unistd.h>
+#include <vector>
+
+namespace siesta {
+
+namespace {
+
+// One span. Guarded by a sequence number in the manner of a seqlock: odd while the owning thread
+// writes it, and 2 * (position + 1) once it holds the span recorded at that ring position.
+struct trace_slot {
+	std::atomic<uint64_t> seq{0};
+	const char* category;
+	const char* name;
+	uint64_t id;
+	int64_t begin_ns;
+	int64_t end_ns;
+	uint8_t detail_size;
+	std::array<char, trace_detail_size> detail;
+};
+
+struct trace_ring {
+	std::array<trace_slot, trace_ring_size> slots;
+	std::atomic<uint64_t> head{0}; // spans ever recorded; only the owner writes it
+	std::atomic<bool> owned{false};
+	uint32_t tid;
+
+	explicit trace_ring(uint32_t tid)
+		: tid(tid) {}
+};
+
+// Rings outlive their threads, so that a dump still shows what exited threads recorded. A new
+// thread takes over the ring of one that exited before allocating another.
+struct ring_registry {
+	std::mutex rings_mutex;
+	std::vector<std::unique_ptr<trace_ring>> rings;
+};
+
+// Never destroyed, so that threads still tracing during static destruction, and their ring_owner
+// on exit, never touch a registry that is gone.
+ring_registry& registry() {
+	static auto* r = new ring_registry;
+	return *r;
+}
+
+struct ring_owner {
+	trace_ring* ring{nullptr};
+
+	~ring_owner() {
+		if (ring != nullptr) {
+			ring->owned.store(false, std::memory_order_release);
+		}
+	}
+};
+thread_local ring_owner local;
+
+// Null if the thread has no ring and none can be allocated or registered.
+trace_ring* local_ring() noexcept {
+	if (local.ring != nullptr) {
+		return local.ring;
+	}
+	auto& r = registry();
+	try {
+		std::lock_guard lock(r.rings_mutex);
+		for (auto& ring : r.rings) {
+			if (!ring->owned.load(std::memory_order_acquire)) {
+				local.ring = ring.get();
+				break;
+			}
+		}
+		if (local.ring == nullptr) {
+			const auto tid = static_cast<uint32_t>(r.rings.size() + 1);
+			local.ring = r.rings.emplace_back(std::make_unique<trace_ring>(tid)).get();
+		}
+		local.ring->owned.store(true, std::memory_order_relaxed);
+	} catch (...) {
+		return nullptr;
+	}
+	return local.ring;
+}
+
+std::atomic<uint64_t> trace_ids{0};
+
+int64_t to_ns(trace_clock::time_point t) {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+void append_number(std::string& out, uint64_t value) {
+	std::array<char, 24> digits;
+	out.append(digits.data(), std::to_chars(digits.data(), digits.data() + digits.size(), value).ptr);
+}
+
+// Chrome trace timestamps are in microseconds; three decimals keep nanoseconds.
+void append_us(std::string& out, int64_t ns) {
+	ns = std::max<int64_t>(ns, 0);
+	append_number(out, static_cast<uint64_t>(ns / 1000));
+	const auto frac = static_cast<unsigned>(ns % 1000);
+	out.push_back('.');
+	out.push_back(static_cast<char>('0' + frac / 100));
+	out.push_back(static_cast<char>('0' + frac / 10 % 10));
+	out.push_back(static_cast<char>('0' + frac % 10));
+}
+
+void append_json_string(std::string& out, std::string_view s) {
+	out.push_back('"');
+	for (const char c : s) {
+		if (c == '"' || c == '\\') {
+			out.push_back('\\');
+			out.push_back(c);
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			static constexpr std::string_view hex = "0123456789abcdef";
+			out.append("\\u00");
+			out.push_back(hex[(c >> 4) & 0xf]);
+			out.push_back(hex[c & 0xf]);
+		} else {
+			out.push_back(c);
+		}
+	}
+	out.push_back('"');
+}
+
+} // namespace
+
+uint64_t next_trace_id() noexcept { return trace_ids.fetch_add(1, std::memory_order_relaxed) + 1; }
+
+void trace_span(const char* category, const char* name, uint64_t id, trace_clock::time_point begin,
+                trace_clock::time_point end, std::string_view detail) noexcept {
+	auto* ring_ptr = local_ring();
+	if (ring_ptr == nullptr) {
+		return;
+	}
+	auto& ring = *ring_ptr;
+	const auto position = ring.head.load(std::memory_order_relaxed);
+	auto& slot = ring.slots[position % trace_ring_size];
+	slot.seq.store(2 * position + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.category = category;
+	slot.name = name;
+	slot.id = id;
+	slot.begin_ns = to_ns(begin);
+	slot.end_ns = to_ns(end);
+	slot.detail_size = static_cast<uint8_t>(std::min(detail.size(), trace_detail_size));
+	std::copy_n(detail.data(), slot.detail_size, slot.detail.data());
+	slot.seq.store(2 * position + 2, std::memory_order_release);
+	ring.head.store(position + 1, std::memory_order_release);
+}
+
+void render_trace(std::string& out) {
+	const auto pid = static_cast<uint64_t>(::getpid());
+	std::vector<trace_ring*> snapshot;
+	{
+		auto& r = registry();
+		std::lock_guard lock(r.rings_mutex);
+		for (auto& ring : r.rings) {
+			snapshot.push_back(ring.get());
+		}
+	}
+	out.append("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	bool first = true;
+	for (const auto* ring : snapshot) {
+		const auto head = ring->head.load(std::memory_order_acquire);
+		for (auto position = head > trace_ring_size ? head - trace_ring_size : 0; position < head; ++position) {
+			const auto& slot = ring->slots[position % trace_ring_size];
+			const auto seq = slot.seq.load(std::memory_order_acquire);
+			const auto category = slot.category;
+			const auto name = slot.name;
+			const auto id = slot.id;
+			const auto begin_ns = slot.begin_ns;
+			const auto end_ns = slot.end_ns;
+			std::array<char, trace_detail_size> detail;
+			const auto detail_size = std::min<std::size_t>(slot.detail_size, trace_detail_size);
+			std::copy_n(slot.detail.data(), detail_size, detail.data());
+			std::atomic_thread_fence(std::memory_order_acquire);
+			// Overwritten by the owner while being copied.
+			if (seq != 2 * position + 2 || slot.seq.load(std::memory_order_relaxed) != seq) {
+				continue;
+			}
+			out.append(first ? "\n" : ",\n");
+			first = false;
+			out.append("{\"name\":");
+			append_json_string(out, name);
+			out.append(",\"cat\":");
+			append_json_string(out, category);
+			out.append(",\"ph\":\"X\",\"pid\":");
+			append_number(out, pid);
+			out.append(",\"tid\":");
+			append_number(out, ring->tid);
+			out.append(",\"ts\":");
+			append_us(out, begin_ns);
+			out.append(",\"dur\":");
+			append_us(out, end_ns - begin_ns);
+			out.append(",\"args\":{\"id\":");
+			append_number(out, id);
+			if (detail_size != 0) {
+				out.append(",\"detail\":");
+				append_json_string(out, {detail.data(), detail_size});
+			}
+			out.append("}}");
+		}
+	}
+	out.append("\n]}\n");
+}
+
+bool dump_trace(const std::string& path) {
+	std::string json;
+	render_trace(json);
+	std::unique_ptr<std::FILE, decltype(&std::fclose)> file(std::fopen(path.c_str(), "w"), std::fclose);
+	if (!file) {
+		return false;
+	}
+	const bool written = std::fwrite(json.data(), 1, json.size(), file.get()) == json.size();
+	return std::fclose(file.release()) == 0 && written;
+}
+
+} // namespace siesta
@@ -5,12 +5,14 @@ Concurrent load test for the siesta echo server.
 
 Sends GET /echo?message=... requests over raw HTTP/1.1 sockets using a
 thread pool for maximum throughput.  Reports latency percentiles and
-requests-per-second.
+requests-per-second, plus the average number of response bytes on the wire.
 
 Usage:
     python3 load_test.py [--host HOST] [--port PORT]
                          [--requests N] [--concurrency C]
-                         [--warmup N] [--keepalive N]
+                         [--warmup N] [--keepalive N] [--pipeline D]
+                         [--payload BYTES] [--accept-encoding CODINGS]
+                         [--unix PATH]
 """
 
 import argparse
@@ -21,49 +23,99 @@ import time
 from concurrent.futures import ThreadPoolExecutor, as_completed
 
 MESSAGE = "hello_load_test_1234567890"
+ACCEPT_ENCODING = ""
+UNIX_PATH = ""
+
+
+def connect(host: str, port: int, timeout: float) -> socket.socket:
+    """Connect over TCP, or to UNIX_PATH when one is set."""
+    if not UNIX_PATH:
+        return socket.create_connection((host, port), timeout=timeout)
+    s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    s.settimeout(timeout)
+    s.connect(UNIX_PATH)
+    return s
+
+
+def make_message(size: int) -> str:
+    """A message of `size` bytes, repeating MESSAGE like a list of similar records would."""
+    if size <= 0:
+        return MESSAGE
+    return (MESSAGE * (size // len(MESSAGE) + 1))[:size]
 
 
 def make_http_request(msg: str) -> bytes:
+    accept = f"Accept-Encoding: {ACCEPT_ENCODING}\r\n" if ACCEPT_ENCODING else ""
     return (
         f"GET /echo?message={msg} HTTP/1.1\r\n"
         "Host: localhost\r\n"
         "Connection: keep-alive\r\n"
+        f"{accept}"
         "\r\n"
     ).encode()
 
 
-def make_request(host: str, port: int) -> tuple[float, bool]:
+def make_request(host: str, port: int) -> tuple[float, bool, int]:
     """Open a fresh connection, send one request, measure latency."""
     t0 = time.perf_counter()
     try:
-        s = socket.create_connection((host, port), timeout=5.0)
+        s = connect(host, port, timeout=5.0)
         s.sendall(make_http_request(MESSAGE))
         buf = read_response(s)
         s.close()
         elapsed = time.perf_counter() - t0
-        return elapsed, b"200 OK" in buf
+        return elapsed, b"200 OK" in buf, len(buf)
     except Exception:
-        return time.perf_counter() - t0, False
+        return time.perf_counter() - t0, False, 0
 
 
-def make_keepalive_requests(host: str, port: int, count: int) -> list[tuple[float, bool]]:
-    """Open one connection, pipeline `count` requests, measure each latency."""
+def make_keepalive_requests(host: str, port: int, count: int,
+                            pipeline: int = 1) -> list[tuple[float, bool, int]]:
+    """Open one connection, send `count` requests with up to `pipeline` of
+    them in flight at once, measure each latency."""
     results = []
     try:
-        s = socket.create_connection((host, port), timeout=10.0)
+        s = connect(host, port, timeout=10.0)
         req = make_http_request(MESSAGE)
-        for _ in range(count):
+        buf = b""
+        sent = 0
+        while sent < count:
+            depth = min(pipeline, count - sent)
             t0 = time.perf_counter()
-            s.sendall(req)
-            buf = read_response(s)
-            elapsed = time.perf_counter() - t0
-            results.append((elapsed, b"200 OK" in buf))
+            s.sendall(req * depth)
+            sent += depth
+            for _ in range(depth):
+                head, buf, size = read_pipelined_response(s, buf)
+                elapsed = time.perf_counter() - t0
+                results.append((elapsed, b"200 OK" in head, size))
         s.close()
     except Exception:
-        results.extend([(0.0, False)] * (count - len(results)))
+        results.extend([(0.0, False, 0)] * (count - len(results)))
     return results
 
 
+def read_pipelined_response(s: socket.socket, buf: bytes) -> tuple[bytes, bytes, int]:
+    """Read one full response (headers + Content-Length body) from `s`.
+    Returns the response head, whatever bytes follow it and the response's size on the wire."""
+    while b"\r\n\r\n" not in buf:
+        chunk = s.recv(65536)
+        if not chunk:
+            raise ConnectionError("connection closed")
+        buf += chunk
+    end = buf.index(b"\r\n\r\n") + 4
+    head = buf[:end]
+    length = 0
+    for line in head.split(b"\r\n"):
+        if line.lower().startswith(b"content-length:"):
+            length = int(line.split(b":", 1)[1])
+    while len(buf) < end + length:
+        chunk = s.recv(65536)
+        if not chunk:
+            raise ConnectionError("connection closed")
+        buf += chunk
+    return head, buf[end + length:], end + length
+
+
 def read_response(s: socket.socket) -> bytes:
     """Read until \r\n\r\n or connection close."""
     buf = b""
@@ -81,20 +133,23 @@ def read_response(s: socket.socket) -> bytes:
 
 
 def run_load_test(host: str, port: int, total: int, concurrency: int,
-                  warmup: int = 0, keepalive: int = 0) -> dict:
+                  warmup: int = 0, keepalive: int = 0, pipeline: int = 1) -> dict:
     """Run load test and return aggregated results."""
 
     latencies: list[float] = []
     ok_count = 0
     fail_count = 0
+    wire_bytes = 0
     lock = threading.Lock()
 
-    print(f"  target: {host}:{port}")
+    print(f"  target: {UNIX_PATH or f'{host}:{port}'}")
     print(f"  requests: {total}, concurrency: {concurrency}")
     if warmup:
         print(f"  warmup: {warmup}")
     if keepalive:
         print(f"  keep-alive: {keepalive} req/conn")
+        if pipeline > 1:
+            print(f"  pipeline depth: {pipeline}")
 
     if keepalive:
         conns_needed = (total + keepalive - 1) // keepalive
@@ -108,7 +163,7 @@ def run_load_test(host: str, port: int, total: int, concurrency: int,
                 for i in range(warm_conns):
                     k = min(keepalive, warmup - i * keepalive)
                     if k > 0:
-                        futures.append(pool.submit(make_keepalive_requests, host, port, k))
+                        futures.append(pool.submit(make_keepalive_requests, host, port, k, pipeline))
                 for fut in as_completed(futures):
                     pass
             print("done")
@@ -120,12 +175,13 @@ def run_load_test(host: str, port: int, total: int, concurrency: int,
             futures = []
             for i in range(conns_needed):
                 k = min(keepalive, total - i * keepalive)
-                futures.append(pool.submit(make_keepalive_requests, host, port, k))
+                futures.append(pool.submit(make_keepalive_requests, host, port, k, pipeline))
 
             for fut in as_completed(futures):
-                for elapsed, ok in fut.result():
+                for elapsed, ok, size in fut.result():
                     with lock:
                         latencies.append(elapsed)
+                        wire_bytes += size
                         if ok:
                             ok_count += 1
                         else:
@@ -148,9 +204,10 @@ def run_load_test(host: str, port: int, total: int, concurrency: int,
         with ThreadPoolExecutor(max_workers=concurrency) as pool:
             futures = [pool.submit(make_request, host, port) for _ in range(total)]
             for fut in as_completed(futures):
-                elapsed, ok = fut.result()
+                elapsed, ok, size = fut.result()
                 with lock:
                     latencies.append(elapsed)
+                    wire_bytes += size
                     if ok:
                         ok_count += 1
                     else:
@@ -168,6 +225,8 @@ def run_load_test(host: str, port: int, total: int, concurrency: int,
         "fail": fail_count,
         "wall_time_s": wall_time,
         "req_per_sec": total / wall_time if wall_time > 0 else 0,
+        "bytes_per_resp": wire_bytes / total if total else 0,
+        "mb_per_sec": wire_bytes / wall_time / 1e6 if wall_time > 0 else 0,
         "latency_p50": latencies[len(latencies) // 2] if latencies else 0,
         "latency_p95": latencies[int(len(latencies) * 0.95)] if latencies else 0,
         "latency_p99": latencies[int(len(latencies) * 0.99)] if latencies else 0,
@@ -191,10 +250,24 @@ def main():
     p.add_argument("--warmup", type=int, default=200)
     p.add_argument("--keepalive", "-k", type=int, default=0,
                    help="Requests per connection (1=new conn each time, >1=reuse)")
+    p.add_argument("--pipeline", "-p", type=int, default=1,
+                   help="Requests in flight per keep-alive connection (HTTP/1.1 pipelining)")
+    p.add_argument("--payload", type=int, default=0,
+                   help="Echoed message size in bytes (default: a short fixed message)")
+    p.add_argument("--accept-encoding", default="",
+                   help="Accept-Encoding sent with every request, e.g. gzip")
+    p.add_argument("--unix", default="",
+                   help="Connect to a UNIX domain socket at this path instead of host:port")
     args = p.parse_args()
 
+    global MESSAGE, ACCEPT_ENCODING, UNIX_PATH
+    MESSAGE = make_message(args.payload)
+    ACCEPT_ENCODING = args.accept_encoding
+    UNIX_PATH = args.unix
+
     results = run_load_test(args.host, args.port, args.requests,
-                            args.concurrency, args.warmup, args.keepalive)
+                            args.concurrency, args.warmup, args.keepalive,
+                            args.pipeline)
 
     print()
     print("══════════════════════════════════════════")
@@ -205,6 +278,8 @@ def main():
     print(f"  Failed:       {results['fail']:>8}")
     print(f"  Wall time:    {results['wall_time_s']:>8.2f} s")
     print(f"  Throughput:   {results['req_per_sec']:>8.0f} req/s")
+    print(f"  Bytes/resp:   {results['bytes_per_resp']:>8.0f} B")
+    print(f"  On the wire:  {results['mb_per_sec']:>8.2f} MB/s")
     print("  ────────────────────────────────────────")
     print(f"  Latency p50:  {format_latency(results['latency_p50']):>8}")
     print(f"  Latency p95:  {format_latency(results['latency_p95']):>8}")
@@ -9,6 +9,10 @@ set -euo pipefail
 #   ./run.sh --quick            # run tests without rebuilding
 #   ./run.sh --server           # start server in foreground (manual testing)
 #   ./run.sh --bench            # bench build + load test
+#   ./run.sh --compress         # bench build + throughput vs bytes on the wire, gzip on/off
+#   ./run.sh --uds              # bench build + load test over TCP, then over a UNIX domain socket
+#   ./run.sh --uring            # bench build + load test on epoll, then io_uring (syscalls/req, p99)
+#   ./run.sh --sockopts         # bench build + pipelined load test per socket option set
 #   ./run.sh --profile          # profile build + load test + CPU report
 #   ./run.sh --load             # load test only (no build / no profile)
 #   ./run.sh --cpp              # C++ tests only
@@ -19,12 +23,21 @@ set -euo pipefail
 #   SIESTA_PREFIX     — path to siesta install (default: ../../build/install)
 #   REQUESTS          — load-test request count (default: mode-dependent)
 #   CONCURRENCY       — load-test workers    (default: mode-dependent)
+#   THREADS           — server io threads    (default: 1, 0 = one per core)
+#   KEEPALIVE         — load-test requests per connection (default: 0, new conn each)
+#   PIPELINE          — load-test requests in flight per keep-alive connection
+#   COMPRESS_MIN      — smallest response body the server compresses (--compress mode, default 256)
+#   UDS_PATH          — UNIX domain socket path for --uds mode (default /tmp/siesta-echo.sock)
+#   SOCKOPTS          — --sockopts sets, "name:server args;..." (default: a built-in sweep)
 
 ROOT="$(cd "$(dirname "$0")/.." && pwd)"
 BUILD="$ROOT/build"
 SERVE="${HOST:-127.0.0.1}"
 PORT="${PORT:-9910}"
+THREADS="${THREADS:-1}"
 SIESTA_PREFIX="${SIESTA_PREFIX:-"$ROOT/../build/install"}"
+SERVER_ARGS=()
+LISTEN_UNIX=""
 
 RED='\033[0;31m'; GREEN='\033[0;32m'; CYAN='\033[0;36m'; NC='\033[0m'
 log()   { echo -e "[$(date +%H:%M:%S)] $*"; }
@@ -43,6 +56,10 @@ Modes:
   --quick         run tests without rebuilding
   --server        start server in foreground (manual testing)
   --bench         bench build + load test (100k req, 200 concurrency)
+  --compress      bench build + echo payload sweep, identity vs gzip
+  --uds           bench build + load test over TCP and over a UNIX domain socket
+  --uring         bench builds + load test on the epoll and io_uring backends
+  --sockopts      bench build + pipelined load test for each socket option set
   --profile       profile build + load test + CPU report (50k req, 100 concurrent)
   --load          load test only (no build, no profile)
   --cpp           C++ tests only (build + run)
@@ -53,6 +70,12 @@ Environment:
   SIESTA_PREFIX        path to siesta install
   REQUESTS             load-test request count
   CONCURRENCY          load-test concurrency
+  THREADS              server io threads (0 = one per core)
+  KEEPALIVE            load-test requests per connection
+  PIPELINE             load-test pipelined requests per keep-alive connection
+  COMPRESS_MIN         smallest response body compressed in --compress mode
+  UDS_PATH             UNIX domain socket path in --uds mode
+  SOCKOPTS             --sockopts sets as "name:server args;..."
 EOF
 	exit 0
 }
@@ -83,18 +106,25 @@ build_target() {
 start_server() {
 	local server_bin="$1"; shift
 	local env_vars=("$@")
-
-	log "starting echo server on ${SERVE}:${PORT}"
+	local args=("${SERVER_ARGS[@]}")
+	local probe="import socket; s=socket.socket(); s.settimeout(1); s.connect(('${SERVE}',${PORT})); s.close()"
+	if [[ -n "$LISTEN_UNIX" ]]; then
+		args+=(--unix "$LISTEN_UNIX")
+		probe="import socket; s=socket.socket(socket.AF_UNIX); s.settimeout(1); s.connect('${LISTEN_UNIX}'); s.close()"
+		log "starting echo server on ${LISTEN_UNIX} (${THREADS} threads)"
+	else
+		log "starting echo server on ${SERVE}:${PORT} (${THREADS} threads)"
+	fi
 	if [[ ${#env_vars[@]} -gt 0 ]]; then
-		env "${env_vars[@]}" "$server_bin" "$SERVE" "$PORT" >/dev/null 2>&1 &
+		env "${env_vars[@]}" "$server_bin" "$SERVE" "$PORT" --threads "$THREADS" "${args[@]}" >/dev/null 2>&1 &
 	else
-		"$server_bin" "$SERVE" "$PORT" >/dev/null 2>&1 &
+		"$server_bin" "$SERVE" "$PORT" --threads "$THREADS" "${args[@]}" >/dev/null 2>&1 &
 	fi
 	local pid=$!
 	echo "$pid"
 
 	for i in $(seq 1 10); do
-		if python3 -c "import socket; s=socket.socket(); s.settimeout(1); s.connect(('${SERVE}',${PORT})); s.close()" 2>/dev/null; then
+		if python3 -c "$probe" 2>/dev/null; then
 			return
 		fi
 		sleep 0.3
@@ -158,10 +188,25 @@ run_python_tests() {
 	return "$rc"
 }
 
+run_python_server_tests() {
+	log "running Python server tests"
+	local out rc=0
+	out=$(python3 "$ROOT/echo/test_server.py" 2>&1) || rc=$?
+	echo "$out"
+	if echo "$out" | grep -q "=== Result:.*0 failed"; then
+		pass "Python server tests passed"
+	else
+		fail "Python server tests failed"
+		rc=1
+	fi
+	return "$rc"
+}
+
 run_load_test() {
 	local py="$ROOT/echo/load_test/load_test.py"
 	local extra_args=()
 	[[ "${KEEPALIVE:-0}" -gt 0 ]] && extra_args+=(--keepalive "$KEEPALIVE")
+	[[ "${PIPELINE:-1}" -gt 1 ]] && extra_args+=(--pipeline "$PIPELINE")
 	info "load test ($REQUESTS req, $CONCURRENCY concurrent)"
 	python3 "$py" \
 		--host "$SERVE" --port "$PORT" \
@@ -206,6 +251,7 @@ mode_sanity() {
 	ensure_build "sanity"
 	build_target echo_server
 	build_target Echo_API
+	build_target Echo_API_server
 	build_target echo_test_client
 
 	local srv_pid
@@ -218,6 +264,7 @@ mode_sanity() {
 	local failed=0
 	run_cpp_tests || failed=1
 	run_python_tests || failed=1
+	run_python_server_tests || failed=1
 
 	kill_server "$srv_pid"
 	trap - EXIT
@@ -234,6 +281,7 @@ mode_quick() {
 	local failed=0
 	"$BUILD/echo_test_client" 2>&1 || failed=1
 	python3 "$ROOT/echo/test_client.py" 2>&1 || failed=1
+	python3 "$ROOT/echo/test_server.py" 2>&1 || failed=1
 	if [[ "$failed" -ne 0 ]]; then
 		fail "some quick tests failed"
 		exit 1
@@ -243,8 +291,8 @@ mode_quick() {
 mode_server() {
 	ensure_build "server"
 	build_target echo_server
-	log "starting echo server on ${SERVE}:${PORT}"
-	exec "$BUILD/echo_server" "$SERVE" "$PORT"
+	log "starting echo server on ${SERVE}:${PORT} (${THREADS} threads)"
+	exec "$BUILD/echo_server" "$SERVE" "$PORT" --threads "$THREADS"
 }
 
 mode_bench() {
@@ -266,6 +314,182 @@ mode_bench() {
 	trap - EXIT
 }
 
+# Runs the same keep-alive load test against a TCP listener and then a UNIX domain socket listener,
+# and prints the two side by side.
+mode_uds() {
+	: "${REQUESTS:=50000}"
+	: "${CONCURRENCY:=50}"
+	: "${KEEPALIVE:=100}"
+	local path="${UDS_PATH:-/tmp/siesta-echo.sock}"
+	ensure_build "bench"
+	build_target echo_server_bench
+
+	local py="$ROOT/echo/load_test/load_test.py"
+	local transport srv_pid out
+	local -A summary
+	for transport in tcp uds; do
+		LISTEN_UNIX=""
+		local target=(--host "$SERVE" --port "$PORT")
+		if [[ "$transport" == uds ]]; then
+			LISTEN_UNIX="$path"
+			target=(--unix "$path")
+		fi
+		if ! srv_pid=$(start_server "$BUILD/echo_server_bench") || [[ -z "$srv_pid" ]]; then
+			fail "could not start server"
+			exit 1
+		fi
+		trap "kill_server $srv_pid" EXIT
+		info "load test over $transport ($REQUESTS req, $CONCURRENCY concurrent)"
+		out=$(python3 "$py" "${target[@]}" \
+			--requests "$REQUESTS" --concurrency "$CONCURRENCY" \
+			--keepalive "$KEEPALIVE" --warmup 50) || { echo "$out"; exit 1; }
+		summary[$transport]=$(echo "$out" | grep -E "Throughput|Latency p50|Latency p99")
+		kill_server "$srv_pid"
+		trap - EXIT
+	done
+	LISTEN_UNIX=""
+
+	echo ""
+	info "TCP loopback:"
+	echo "${summary[tcp]}"
+	info "UNIX domain socket:"
+	echo "${summary[uds]}"
+}
+
+# Runs the same keep-alive load test against echo_server_bench (epoll) and echo_server_uring_bench
+# (io_uring), counting the server's system calls with perf when it is available, and prints the two
+# side by side. The io_uring server needs siesta installed with -DSIESTA_IO_URING=ON.
+mode_uring() {
+	: "${REQUESTS:=50000}"
+	: "${CONCURRENCY:=50}"
+	: "${KEEPALIVE:=100}"
+	ensure_build "bench"
+	if ! ninja -C "$BUILD" -t targets all | grep -q '^echo_server_uring_bench:'; then
+		fail "echo_server_uring_bench is missing; rebuild siesta with -DSIESTA_IO_URING=ON"
+		exit 1
+	fi
+	build_target echo_server_bench
+	build_target echo_server_uring_bench
+
+	local py="$ROOT/echo/load_test/load_test.py"
+	local server srv_pid out perf_pid perf_out calls
+	local -A summary
+	for server in echo_server_bench echo_server_uring_bench; do
+		if ! srv_pid=$(start_server "$BUILD/$server") || [[ -z "$srv_pid" ]]; then
+			fail "could not start server"
+			exit 1
+		fi
+		trap "kill_server $srv_pid" EXIT
+		perf_out=""
+		if command -v perf >/dev/null; then
+			perf_out=$(mktemp)
+			perf stat -x, -e raw_syscalls:sys_enter -p "$srv_pid" -o "$perf_out" &
+			perf_pid=$!
+		fi
+		info "load test on $server ($REQUESTS req, $CONCURRENCY concurrent)"
+		out=$(python3 "$py" --host "$SERVE" --port "$PORT" \
+			--requests "$REQUESTS" --concurrency "$CONCURRENCY" \
+			--keepalive "$KEEPALIVE" --warmup 50) || { echo "$out"; exit 1; }
+		summary[$server]=$(echo "$out" | grep -E "Throughput|Latency p50|Latency p99")
+		if [[ -n "$perf_out" ]]; then
+			kill -INT "$perf_pid" 2>/dev/null || true
+			wait "$perf_pid" 2>/dev/null || true
+			calls=$(awk -F, '/raw_syscalls:sys_enter/ { print $1 }' "$perf_out")
+			if [[ "$calls" =~ ^[0-9]+$ ]]; then
+				summary[$server]+=$'\n'"$(awk -v c="$calls" -v n="$((REQUESTS + 50))" \
+					'BEGIN { printf "  Syscalls/req: %8.2f", c / n }')"
+			fi
+			rm -f "$perf_out"
+		fi
+		kill_server "$srv_pid"
+		trap - EXIT
+	done
+
+	echo ""
+	info "epoll:"
+	echo "${summary[echo_server_bench]}"
+	info "io_uring:"
+	echo "${summary[echo_server_uring_bench]}"
+}
+
+# Restarts the bench server with each set of socket options and runs the same pipelined keep-alive
+# load test against it. Pipelined responses are the small back-to-back writes where Nagle and
+# delayed ACKs interact, so a set that loses tens of milliseconds shows up in p99.
+mode_sockopts() {
+	: "${REQUESTS:=20000}"
+	: "${CONCURRENCY:=20}"
+	: "${KEEPALIVE:=100}"
+	: "${PIPELINE:=4}"
+	local sets="${SOCKOPTS:-defaults:;nagle:--no-delay 0;nagle+quickack:--no-delay 0 --quick-ack;quickack:--quick-ack;defer-accept:--defer-accept 1;fast-open:--fast-open 256;busy-poll:--busy-poll 50;backlog:--backlog 4096;buffers:--rcvbuf 262144 --sndbuf 262144}"
+	ensure_build "bench"
+	build_target echo_server_bench
+
+	local py="$ROOT/echo/load_test/load_test.py"
+	local set name srv_pid out
+	local -a names
+	local -A summary
+	IFS=';' read -ra entries <<< "$sets"
+	for set in "${entries[@]}"; do
+		name="${set%%:*}"
+		read -ra SERVER_ARGS <<< "${set#*:}"
+		if ! srv_pid=$(start_server "$BUILD/echo_server_bench") || [[ -z "$srv_pid" ]]; then
+			fail "could not start server"
+			exit 1
+		fi
+		trap "kill_server $srv_pid" EXIT
+		info "$name: ${SERVER_ARGS[*]:-(defaults)}"
+		out=$(python3 "$py" --host "$SERVE" --port "$PORT" \
+			--requests "$REQUESTS" --concurrency "$CONCURRENCY" \
+			--keepalive "$KEEPALIVE" --pipeline "$PIPELINE" --warmup 50) || { echo "$out"; exit 1; }
+		names+=("$name")
+		summary[$name]=$(echo "$out" | grep -E "Throughput|Latency p50|Latency p99|Failed")
+		kill_server "$srv_pid"
+		trap - EXIT
+	done
+	SERVER_ARGS=()
+
+	echo ""
+	for name in "${names[@]}"; do
+		info "$name:"
+		echo "${summary[$name]}"
+	done
+}
+
+# Echoes payloads of several sizes with and without Accept-Encoding: gzip against a server that
+# compresses bodies from COMPRESS_MIN bytes up, and reports throughput next to bytes on the wire.
+# Payloads stay under the 8 KiB request header limit since the message travels in the query.
+mode_compress() {
+	: "${REQUESTS:=20000}"
+	: "${CONCURRENCY:=50}"
+	: "${KEEPALIVE:=100}"
+	ensure_build "bench"
+	build_target echo_server_bench
+
+	SERVER_ARGS=(--compress-min "${COMPRESS_MIN:-256}")
+	local srv_pid
+	if ! srv_pid=$(start_server "$BUILD/echo_server_bench") || [[ -z "$srv_pid" ]]; then
+		fail "could not start server"
+		exit 1
+	fi
+	trap "kill_server $srv_pid" EXIT
+
+	local py="$ROOT/echo/load_test/load_test.py"
+	for size in 64 512 2048 7000; do
+		for encoding in "" gzip; do
+			info "payload ${size} B, Accept-Encoding: ${encoding:-(none)}"
+			python3 "$py" \
+				--host "$SERVE" --port "$PORT" \
+				--requests "$REQUESTS" --concurrency "$CONCURRENCY" \
+				--keepalive "$KEEPALIVE" --warmup 50 \
+				--payload "$size" --accept-encoding "$encoding" \
+				| grep -E "Throughput|Bytes/resp|On the wire|Failed" || exit 1
+		done
+	done
+
+	kill_server "$srv_pid"
+	trap - EXIT
+}
+
 mode_profile() {
 	: "${REQUESTS:=50000}"
 	: "${CONCURRENCY:=100}"
@@ -322,6 +546,7 @@ mode_py() {
 	ensure_build "py"
 	build_target echo_server
 	build_target Echo_API
+	build_target Echo_API_server
 
 	local srv_pid
 	if ! srv_pid=$(start_server "$BUILD/echo_server") || [[ -z "$srv_pid" ]]; then
@@ -334,6 +559,8 @@ mode_py() {
 
 	kill_server "$srv_pid"
 	trap - EXIT
+
+	run_python_server_tests || exit 1
 }
 
 # ── Main ───────────────────────────────────────────────────────
@@ -343,6 +570,10 @@ case "${1:-}" in
 	--quick)     mode_quick ;;
 	--server)    mode_server ;;
 	--bench)     mode_bench ;;
+	--compress)  mode_compress ;;
+	--uds)       mode_uds ;;
+	--uring)     mode_uring ;;
+	--sockopts)  mode_sockopts ;;
 	--profile)   mode_profile ;;
 	--load)      mode_load ;;
 	--cpp)       mode_cpp ;;
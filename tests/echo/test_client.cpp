@@ -1,6 +1,9 @@
 #include "client.hpp"
 
 #include <boost/asio/use_future.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/core/tcp_stream.hpp>
+#include <boost/beast/http.hpp>
 #include <boost/json.hpp>
 #include <catch2/catch_test_macros.hpp>
 #include <cstdlib>
@@ -69,3 +72,16 @@ TEST_CASE("echo with header param", "[integration]") {
 	auto resp = call_echo(client, ctx, "test", std::string("custom-value"));
 	REQUIRE(resp.message == "test");
 }
+
+TEST_CASE("echo form-encoded query value", "[integration]") {
+	namespace http = boost::beast::http;
+	boost::asio::io_context ctx;
+	boost::beast::tcp_stream stream(ctx);
+	stream.connect({boost::asio::ip::make_address(echo_host()), echo_port()});
+	http::write(stream, http::request<http::empty_body>{http::verb::get, "/echo?message=a+b%2Bc%20d", 11});
+	boost::beast::flat_buffer buffer;
+	http::response<http::string_body> res;
+	http::read(stream, buffer, res);
+	REQUIRE(res.result() == http::status::ok);
+	REQUIRE(boost::json::value_to<Echo_API::EchoResponse>(boost::json::parse(res.body())).message == "a b+c d");
+}
@@ -1,7 +1,8 @@
 // SPDX-License-Identifier: Apache-2.0
 // Test server binary — concrete openapi::Server implementation.
-// Usage: ./test_server [host] [port]
-// Default: ./test_server 127.0.0.1 9900
+// Usage: ./test_server [host] [port] [--threads N] [--compress-min BYTES] [--unix PATH]
+// Default: ./test_server 127.0.0.1 9900 --threads 1
+// With --unix the server listens on a UNIX domain socket at PATH instead of host:port.
 
 #include "server.hpp"
 
@@ -10,8 +11,10 @@
 #include <csignal>
 #include <cstdio>
 #include <iostream>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #ifdef ENABLE_PROFILER
 #include <gperftools/profiler.h>
@@ -20,48 +23,22 @@
 namespace asio = ::boost::asio;
 namespace http = ::boost::beast::http;
 
-static std::string url_decode(std::string_view sv) {
-	std::string result;
-	result.reserve(sv.size());
-	for (size_t i = 0; i < sv.size(); ++i) {
-		if (sv[i] == '%' && i + 2 < sv.size()) {
-			char hi = sv[i + 1];
-			char lo = sv[i + 2];
-			auto hex = [](char c) -> int {
-				if (c >= '0' && c <= '9') return c - '0';
-				if (c >= 'A' && c <= 'F') return c - 'A' + 10;
-				if (c >= 'a' && c <= 'f') return c - 'a' + 10;
-				return -1;
-			};
-			int h = hex(hi), l = hex(lo);
-			if (h >= 0 && l >= 0) {
-				result += static_cast<char>((h << 4) | l);
-				i += 2;
-				continue;
-			}
-		}
-		result += sv[i];
-	}
-	return result;
-}
-
 struct EchoServer : Echo_API::Server {
 	using Echo_API::Server::Server;
 
-	void get__echo(const request req, Session::Ptr session) override {
-		std::string_view target = req.target();
-		std::string_view value;
-		if (auto pos = target.find("message="); pos != std::string_view::npos) {
-			value = target.substr(pos + 8);
-			if (auto amp = value.find('&'); amp != std::string_view::npos)
-				value = value.substr(0, amp);
-		}
+	void get__echo(request&, Session::Ptr session, std::string message, std::optional<std::string>) override {
+		auto& resp = session->get_response();
+		resp.result(http::status::ok);
+		// Content-Type comes from the endpoint's pre-rendered header block; Content-Length is written
+		// by the session.
+		resp.body() = "{\"message\":\"" + message + "\"}";
+		session->write();
+	}
 
+	void post__echo(request&, Session::Ptr session, Echo_API::EchoRequest body) override {
 		auto& resp = session->get_response();
 		resp.result(http::status::ok);
-		resp.body() = "{\"message\":\"" + url_decode(value) + "\"}";
-		resp.set(http::field::content_type, "application/json");
-		resp.prepare_payload();
+		resp.body() = "{\"message\":\"" + body.message + "\"}";
 		session->write();
 	}
 };
@@ -79,8 +56,45 @@ static void handle_signal(int) {
 #endif
 
 int main(int argc, char* argv[]) {
-	std::string host = argc > 1 ? argv[1] : "127.0.0.1";
-	uint16_t port = argc > 2 ? static_cast<uint16_t>(std::stoi(argv[2])) : 9900;
+	Echo_API::Server::Config config;
+	std::vector<std::string_view> args;
+	std::string unix_path;
+	for (int i = 1; i < argc; ++i) {
+		std::string_view arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc) {
+			config.threads = std::stoul(argv[++i]);
+		} else if (arg == "--unix" && i + 1 < argc) {
+			unix_path = argv[++i];
+		} else if (arg == "--compress-min" && i + 1 < argc) {
+			config.compress_min_size = std::stoul(argv[++i]);
+		} else if (arg == "--no-delay" && i + 1 < argc) {
+			config.socket.no_delay = std::stoi(argv[++i]) != 0;
+		} else if (arg == "--quick-ack") {
+			config.socket.quick_ack = true;
+		} else if (arg == "--backlog" && i + 1 < argc) {
+			config.socket.backlog = std::stoi(argv[++i]);
+		} else if (arg == "--defer-accept" && i + 1 < argc) {
+			config.socket.defer_accept = std::stoi(argv[++i]);
+		} else if (arg == "--fast-open" && i + 1 < argc) {
+			config.socket.fast_open = std::stoi(argv[++i]);
+		} else if (arg == "--busy-poll" && i + 1 < argc) {
+			config.socket.busy_poll = std::stoi(argv[++i]);
+		} else if (arg == "--rcvbuf" && i + 1 < argc) {
+			config.socket.receive_buffer = std::stoi(argv[++i]);
+		} else if (arg == "--sndbuf" && i + 1 < argc) {
+			config.socket.send_buffer = std::stoi(argv[++i]);
+		} else if (arg == "--metrics") {
+			config.metrics = true;
+		} else if (arg == "--trace" && i + 1 < argc) {
+			// Samples one request in N; SIGUSR2 writes the trace to siesta-trace.json.
+			config.trace_sample = std::stoul(argv[++i]);
+			config.trace_signal = SIGUSR2;
+		} else {
+			args.push_back(arg);
+		}
+	}
+	std::string host = args.size() > 0 ? std::string(args[0]) : "127.0.0.1";
+	uint16_t port = args.size() > 1 ? static_cast<uint16_t>(std::stoi(std::string(args[1]))) : 9900;
 
 #ifdef ENABLE_PROFILER
 	const char* profile_path = getenv("CPUPROFILE");
@@ -92,9 +106,15 @@ int main(int argc, char* argv[]) {
 #endif
 
 	asio::io_context ctx;
-	EchoServer server(ctx);
-	server.start(asio::ip::make_address(host), port);
-	std::cout << "echo-server listening on " << host << ":" << port << std::endl;
+	EchoServer server(ctx, config);
+	if (unix_path.empty()) {
+		server.start(asio::ip::make_address(host), port);
+		std::cout << "echo-server listening on " << host << ":" << port;
+	} else {
+		server.start(asio::local::stream_protocol::endpoint(unix_path));
+		std::cout << "echo-server listening on " << unix_path;
+	}
+	std::cout << " (" << config.threads << " threads)" << std::endl;
 	ctx.run();
 
 #ifdef ENABLE_PROFILER
@@ -0,0 +1,128 @@
+# SPDX-License-Identifier: Apache-2.0
+"""Integration tests for the generated Python server bindings (Echo_API_server).
+
+Handlers written in Python are served on a UNIX domain socket and called over raw HTTP.
+
+Usage (via run.sh):
+    python3 test/test_server.py
+"""
+
+import http.client
+import json
+import os
+import socket
+import sys
+import traceback
+
+
+class UnixConnection(http.client.HTTPConnection):
+    def __init__(self, path):
+        super().__init__("localhost")
+        self.path = path
+
+    def connect(self):
+        self.sock = socket.socket(socket.AF_UNIX)
+        self.sock.connect(self.path)
+
+
+def post(path, body, headers=None):
+    conn = UnixConnection(path)
+    try:
+        conn.request("POST", "/echo", body=body, headers={"Content-Type": "application/json", **(headers or {})})
+        res = conn.getresponse()
+        return res.status, res.read()
+    finally:
+        conn.close()
+
+
+def test_json_body(path):
+    """POST /echo with a JSON body reaches the Python handler as its JSON text."""
+    status, body = post(path, json.dumps({"message": "hello"}))
+    assert status == 200, f"expected 200, got {status}: {body!r}"
+    result = json.loads(body)
+    assert result.get("message") == "hello", f"expected 'hello', got {result}"
+    return True
+
+
+def test_json_body_escapes(path):
+    """Quotes and non-ASCII text survive the decode and the round trip to Python."""
+    message = 'say "hi" à bientôt'
+    status, body = post(path, json.dumps({"message": message}))
+    assert status == 200, f"expected 200, got {status}: {body!r}"
+    assert json.loads(body)["message"] == message, f"got {body!r}"
+    return True
+
+
+def test_malformed_body(path):
+    """A body that is not JSON is rejected before the Python handler runs."""
+    status, body = post(path, '{"message": ')
+    assert status == 400, f"expected 400, got {status}: {body!r}"
+    return True
+
+
+def test_trailing_bytes(path):
+    """Bytes after the JSON value are rejected; trailing whitespace is not."""
+    status, body = post(path, '{"message": "hi"} {"message": "again"}')
+    assert status == 400, f"expected 400, got {status}: {body!r}"
+    status, body = post(path, '{"message": "hi"}\r\n')
+    assert status == 200, f"expected 200, got {status}: {body!r}"
+    return True
+
+
+TESTS = [
+    ("json body", test_json_body),
+    ("json body escapes", test_json_body_escapes),
+    ("malformed body", test_malformed_body),
+    ("trailing bytes", test_trailing_bytes),
+]
+
+
+def main():
+    build_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "build")
+    sys.path.insert(0, build_dir)
+
+    try:
+        from Echo_API_server import Server  # type: ignore
+    except ImportError:
+        print(f"FAIL: cannot import Echo_API_server (Server) from {build_dir}", file=sys.stderr)
+        traceback.print_exc()
+        return 1
+
+    class EchoServer(Server):
+        def post__echo(self, request):
+            return {"message": json.loads(request["body"])["message"]}
+
+    path = f"/tmp/siesta-echo-py-{os.getpid()}.sock"
+    server = EchoServer()
+    server.listen_unix(path)
+    print(f"serving on {path} ...")
+
+    passed = 0
+    failed = 0
+
+    for name, test_fn in TESTS:
+        ok = False
+        try:
+            ok = test_fn(path)
+        except Exception:
+            traceback.print_exc()
+        if ok:
+            print(f"  PASS: {name}")
+            passed += 1
+        else:
+            print(f"  FAIL: {name}")
+            failed += 1
+
+    server.shutdown()
+    try:
+        os.unlink(path)
+    except OSError:
+        pass
+
+    print()
+    print(f"=== Result: {passed} passed, {failed} failed ===")
+    return 0 if failed == 0 else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
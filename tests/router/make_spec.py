@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""Generate the synthetic OpenAPI spec and lookup table used by router_bench.
+
+Each of the N resources contributes 12 operations spread over static and
+templated paths, including a static segment ("search") that competes with a
+templated sibling ("{id}"), so the benchmark covers static precedence.
+
+Usage: make_spec.py <spec.json> <cases.inc> [--resources N]
+"""
+
+import argparse
+import json
+
+
+def function_name(method, path):
+    """Mirror of codegen::generateFunctionName."""
+    out = method + "__"
+    first = True
+    for c in path:
+        if c == "/":
+            if not first:
+                out += "_"
+        elif c == "{":
+            out += "_"
+        elif c == "}":
+            pass
+        elif c in ":-":
+            out += "_"
+        else:
+            out += c
+            first = False
+    return out
+
+
+def concrete(path, n):
+    """Substitute every {param} in path with a sample value."""
+    parts = []
+    for seg in path.split("/"):
+        if seg.startswith("{") and seg.endswith("}"):
+            parts.append(f"{seg[1:-1]}{n}")
+        else:
+            parts.append(seg)
+    return "/".join(parts)
+
+
+def operation(path):
+    params = [
+        {"name": seg[1:-1], "in": "path", "required": True, "schema": {"type": "string"}}
+        for seg in path.split("/")
+        if seg.startswith("{") and seg.endswith("}")
+    ]
+    content = {"application/json": {"schema": {"$ref": "#/components/schemas/Item"}}}
+    op = {"responses": {"200": {"description": "OK", "content": content}}}
+    if params:
+        op["parameters"] = params
+    return op
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("spec")
+    parser.add_argument("cases")
+    parser.add_argument("--resources", type=int, default=32)
+    args = parser.parse_args()
+
+    routes = []
+    for r in range(args.resources):
+        base = f"/v1/res{r}"
+        routes += [(base, "get"), (base, "post")]
+        routes += [(base + "/search", "get")]
+        routes += [(base + "/{id}", m) for m in ("get", "put", "delete")]
+        for k in range(3):
+            routes += [(f"{base}/{{id}}/sub{k}", "get"), (f"{base}/{{id}}/sub{k}/{{subId}}", "get")]
+        routes += [(base + "/{id}/actions/{action}", "post")]
+
+    paths = {}
+    for path, method in routes:
+        paths.setdefault(path, {})[method] = operation(path)
+    spec = {
+        "openapi": "3.0.0",
+        "info": {"title": "Router Bench", "version": "1.0.0"},
+        "paths": paths,
+        "components": {
+            "schemas": {
+                "Item": {"properties": {"id": {"type": "string"}}},
+            },
+        },
+    }
+    with open(args.spec, "w") as f:
+        json.dump(spec, f, indent=1)
+
+    with open(args.cases, "w") as f:
+        f.write("// Generated by make_spec.py -- do not edit.\n")
+        for n, (path, method) in enumerate(routes):
+            verb = "delete_" if method == "delete" else method
+            f.write(f'{{"{concrete(path, n)}", http::verb::{verb}, Route::{function_name(method, path)}}},\n')
+
+
+if __name__ == "__main__":
+    main()
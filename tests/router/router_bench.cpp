@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: Apache-2.0
+#include <catch2/catch_all.hpp>
+
+#include <string_view>
+#include <vector>
+
+#include "server.hpp"
+
+namespace http = ::boost::beast::http;
+using Route = Router_Bench::Server::Route;
+using Captures = Router_Bench::Server::Captures;
+
+namespace {
+
+struct Case {
+	std::string_view path;
+	http::verb method;
+	Route expected;
+};
+
+const std::vector<Case> CASES = {
+#include "router_cases.inc"
+};
+
+Route route(std::string_view path, http::verb method) {
+	Captures captures;
+	return Router_Bench::Server::route(path, method, captures);
+}
+
+} // namespace
+
+TEST_CASE("every synthetic path resolves to its endpoint", "[router]") {
+	REQUIRE(CASES.size() > 300);
+	for (const auto& c : CASES) {
+		INFO(c.path);
+		REQUIRE(route(c.path, c.method) == c.expected);
+	}
+}
+
+TEST_CASE("static segments take precedence over params", "[router]") {
+	REQUIRE(route("/v1/res3/search", http::verb::get) == Route::get__v1_res3_search);
+	// No PUT on the static route, so matching backtracks into the {id} sibling.
+	REQUIRE(route("/v1/res3/search", http::verb::put) == Route::put__v1_res3__id);
+	REQUIRE(route("/v1/res3/search/sub1", http::verb::get) == Route::get__v1_res3__id_sub1);
+}
+
+TEST_CASE("templated segments are captured as views into the path", "[router]") {
+	constexpr std::string_view path = "/v1/res7/item-42/sub2/99";
+	Captures captures;
+	REQUIRE(Router_Bench::Server::route(path, http::verb::get, captures) == Route::get__v1_res7__id_sub2__subId);
+	REQUIRE(captures[0] == "item-42");
+	REQUIRE(captures[1] == "99");
+	REQUIRE(captures[0].data() == path.data() + 9);
+
+	// A backtracked static match leaves the param capture in place.
+	REQUIRE(Router_Bench::Server::route("/v1/res7/search/actions/run", http::verb::post, captures) ==
+	        Route::post__v1_res7__id_actions__action);
+	REQUIRE(captures[0] == "search");
+	REQUIRE(captures[1] == "run");
+}
+
+TEST_CASE("unknown paths and methods do not resolve", "[router]") {
+	REQUIRE(route("/", http::verb::get) == Route::none);
+	REQUIRE(route("/v1", http::verb::get) == Route::none);
+	REQUIRE(route("/v1/res999", http::verb::get) == Route::none);
+	REQUIRE(route("/v1/res0/", http::verb::get) == Route::none);
+	REQUIRE(route("/v1/res0//sub0", http::verb::get) == Route::none);
+	REQUIRE(route("/v1/res0/42/sub0/7/extra", http::verb::get) == Route::none);
+	REQUIRE(route("/v1/res0", http::verb::patch) == Route::none);
+	// Targets not starting with '/' must not have their first character taken for one.
+	REQUIRE(route("Xv1/res0", http::verb::get) == Route::none);
+	REQUIRE(route("v1/res0", http::verb::get) == Route::none);
+	REQUIRE(route("http://localhost/v1/res0", http::verb::get) == Route::none);
+	REQUIRE(route("*", http::verb::options) == Route::none);
+}
+
+TEST_CASE("router throughput", "[router][benchmark]") {
+	BENCHMARK("hit, every path") {
+		std::size_t hits = 0;
+		for (const auto& c : CASES) {
+			hits += route(c.path, c.method) != Route::none;
+		}
+		return hits;
+	};
+
+	BENCHMARK("hit, deepest templated path") {
+		return route("/v1/res31/12345/sub2/67890", http::verb::get);
+	};
+
+	BENCHMARK("miss, last resource") {
+		return route("/v1/res31/12345/sub9/67890", http::verb::get);
+	};
+}
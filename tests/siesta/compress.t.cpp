@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: Apache-2.0
+#include <catch2/catch_all.hpp>
+#include <siesta/compress.hpp>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string sample() {
+	std::string json = "[";
+	for (int i = 0; i < 500; ++i) {
+		json += "{\"id\":" + std::to_string(i) + ",\"message\":\"hello\"},";
+	}
+	json.back() = ']';
+	return json;
+}
+
+} // namespace
+
+TEST_CASE("Accept-Encoding picks the best coding offered", "[compress]") {
+	using siesta::coding;
+	REQUIRE(siesta::negotiate_coding("") == coding::identity);
+	REQUIRE(siesta::negotiate_coding("identity") == coding::identity);
+	REQUIRE(siesta::negotiate_coding("br, gzip, deflate") == coding::gzip);
+	REQUIRE(siesta::negotiate_coding("GZIP") == coding::gzip);
+	REQUIRE(siesta::negotiate_coding("deflate") == coding::deflate);
+	REQUIRE(siesta::negotiate_coding("gzip;q=0.5, deflate") == coding::deflate);
+	REQUIRE(siesta::negotiate_coding("gzip;q=0, deflate;q=0") == coding::identity);
+	REQUIRE(siesta::negotiate_coding("*") == coding::gzip);
+	REQUIRE(siesta::negotiate_coding("gzip;q=0, *") == coding::deflate);
+}
+
+TEST_CASE("compressed bodies round-trip through the reused streams", "[compress]") {
+	const auto in = sample();
+	for (const auto c : {siesta::coding::gzip, siesta::coding::deflate}) {
+		INFO(siesta::coding_name(c));
+		// Twice per coding: the second pass runs on the reset thread-local stream.
+		for (int pass = 0; pass < 2; ++pass) {
+			std::vector<char> out(siesta::compress_bound(c, in.size()));
+			const auto size = siesta::compress(c, 6, in, out.data());
+			REQUIRE(size > 0);
+			REQUIRE(size < in.size() / 4);
+			std::string back;
+			REQUIRE(siesta::decompress(c, {out.data(), size}, back));
+			REQUIRE(back == in);
+			REQUIRE(siesta::parse_coding(siesta::coding_name(c)) == c);
+		}
+	}
+}
+
+TEST_CASE("truncated and oversized streams are refused", "[compress]") {
+	const auto in = sample();
+	const auto c = siesta::coding::gzip;
+	std::vector<char> out(siesta::compress_bound(c, in.size()));
+	const auto size = siesta::compress(c, 1, in, out.data());
+	REQUIRE(size > 0);
+
+	std::string back = "kept";
+	REQUIRE_FALSE(siesta::decompress(c, {out.data(), size / 2}, back));
+	REQUIRE(back == "kept");
+	REQUIRE_FALSE(siesta::decompress(c, {out.data(), size}, back, in.size() - 1));
+	REQUIRE(back == "kept");
+	REQUIRE(siesta::decompress(c, {out.data(), size}, back, in.size()));
+	REQUIRE(back == "kept" + in);
+}
+
+TEST_CASE("decompression stops at the limit", "[compress]") {
+	// 64 MiB of zeros deflate to a few dozen KiB.
+	const std::string zeros(64 << 20, '\0');
+	const auto c = siesta::coding::gzip;
+	std::vector<char> bomb(siesta::compress_bound(c, zeros.size()));
+	const auto size = siesta::compress(c, 9, zeros, bomb.data());
+	REQUIRE(size > 0);
+	REQUIRE(size < 256 << 10);
+
+	std::string back;
+	REQUIRE_FALSE(siesta::decompress(c, {bomb.data(), size}, back, 1 << 20));
+	REQUIRE(back.empty());
+	// Refused within a few output steps of the limit, not after inflating everything.
+	REQUIRE(back.capacity() < 8 << 20);
+}
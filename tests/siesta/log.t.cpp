@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: Apache-2.0
+#include <catch2/catch_all.hpp>
+#include <siesta/log.hpp>
+
+#include <boost/asio/error.hpp>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct captured {
+	std::mutex mutex;
+	std::string text;
+
+	std::vector<std::string> lines(std::string_view facility) {
+		std::lock_guard lock(mutex);
+		std::vector<std::string> out;
+		const auto key = ' ' + std::string(facility);
+		for (std::size_t at = 0; at < text.size();) {
+			const auto end = text.find('\n', at);
+			REQUIRE(end != std::string::npos);
+			auto line = text.substr(at, end - at);
+			const auto field = line.find(key);
+			if (field != std::string::npos && (field + key.size() == line.size() || line[field + key.size()] == ' ')) {
+				out.push_back(std::move(line));
+			}
+			at = end + 1;
+		}
+		return out;
+	}
+};
+
+void capture(captured& into, siesta::log_level level, uint32_t rate_limit = 0) {
+	siesta::configure_log({
+	    .level = level,
+	    .rate_limit = rate_limit,
+	    .sink =
+	        [&into](std::string_view lines) {
+		        std::lock_guard lock(into.mutex);
+		        into.text.append(lines);
+	        },
+	});
+}
+
+} // namespace
+
+TEST_CASE("records below the level are discarded", "[log]") {
+	captured out;
+	capture(out, siesta::log_level::warning);
+	REQUIRE_FALSE(siesta::log_enabled(siesta::log_level::info));
+	REQUIRE(siesta::log_enabled(siesta::log_level::error));
+	siesta::log_message(siesta::log_level::info, "levels", "quiet");
+	siesta::log_message(siesta::log_level::warning, "levels", "loud");
+	siesta::flush_log();
+	const auto lines = out.lines("levels");
+	REQUIRE(lines.size() == 1);
+	REQUIRE(lines[0].find(" warning levels msg=\"loud\"") != std::string::npos);
+	siesta::configure_log({});
+}
+
+TEST_CASE("records carry time, session and error fields", "[log]") {
+	captured out;
+	capture(out, siesta::log_level::debug);
+	siesta::log_error(siesta::log_level::error, "fields", boost::asio::error::connection_reset, 42);
+	siesta::log_message(siesta::log_level::debug, "fields", "a \"quoted\"\nline");
+	siesta::flush_log();
+	const auto lines = out.lines("fields");
+	REQUIRE(lines.size() == 2);
+	// 2026-01-02T03:04:05.678901Z
+	REQUIRE(lines[0].size() > 28);
+	REQUIRE(lines[0][4] == '-');
+	REQUIRE(lines[0][10] == 'T');
+	REQUIRE(lines[0][19] == '.');
+	REQUIRE(lines[0][26] == 'Z');
+	REQUIRE(lines[0].find(" error fields session=42 error=\"system:104 ") != std::string::npos);
+	REQUIRE(lines[1].find(" debug fields msg=\"a \\\"quoted\\\"\\nline\"") != std::string::npos);
+	REQUIRE(lines[1].find("session=") == std::string::npos);
+	siesta::configure_log({});
+}
+
+TEST_CASE("long text is cut", "[log]") {
+	captured out;
+	capture(out, siesta::log_level::info);
+	siesta::log_message(siesta::log_level::info, "long", std::string(200, 'x'));
+	siesta::flush_log();
+	const auto lines = out.lines("long");
+	REQUIRE(lines.size() == 1);
+	REQUIRE(lines[0].ends_with("msg=\"" + std::string(95, 'x') + "\""));
+	siesta::configure_log({});
+}
+
+TEST_CASE("a facility over its rate limit is counted, not logged", "[log]") {
+	captured out;
+	capture(out, siesta::log_level::info, 5);
+	std::thread([] {
+		for (int i = 0; i < 20; ++i) {
+			siesta::log_message(siesta::log_level::info, "burst", "record");
+		}
+		// The count of suppressed records comes with the facility's first record of a later second.
+		std::this_thread::sleep_for(std::chrono::milliseconds{1100});
+		siesta::log_message(siesta::log_level::info, "burst", "after");
+	}).join();
+	siesta::flush_log();
+	std::size_t kept = 0;
+	std::size_t suppressed = 0;
+	bool after = false;
+	for (const auto& line : out.lines("burst")) {
+		if (line.ends_with("msg=\"record\"")) {
+			++kept;
+		} else if (line.ends_with("msg=\"after\"")) {
+			after = true;
+		} else {
+			const auto at = line.find("msg=\"");
+			REQUIRE(line.find(" records suppressed by the rate limit") != std::string::npos);
+			suppressed += std::stoul(line.substr(at + 5));
+		}
+	}
+	// Twice the limit at most, should the burst straddle a second.
+	REQUIRE(kept >= 5);
+	REQUIRE(kept <= 10);
+	REQUIRE(kept + suppressed == 20);
+	REQUIRE(after);
+	siesta::configure_log({});
+}
+
+TEST_CASE("the drain thread delivers without flushing", "[log]") {
+	captured out;
+	capture(out, siesta::log_level::info);
+	siesta::log_message(siesta::log_level::info, "background", "drained");
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+	while (out.lines("background").empty() && std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::sleep_for(std::chrono::milliseconds{10});
+	}
+	REQUIRE(out.lines("background").size() == 1);
+	siesta::configure_log({});
+}
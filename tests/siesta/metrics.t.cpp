@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: Apache-2.0
+#include <catch2/catch_all.hpp>
+#include <siesta/metrics.hpp>
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+TEST_CASE("histogram buckets bound every value within a quarter", "[metrics]") {
+	using siesta::histogram;
+	for (uint64_t v = 0; v < 4096; ++v) {
+		const auto b = histogram::bucket(v);
+		REQUIRE(histogram::lower_bound(b) <= v);
+		REQUIRE(histogram::bucket(histogram::lower_bound(b)) == b);
+		if (v >= histogram::sub_buckets) {
+			REQUIRE(v - histogram::lower_bound(b) < histogram::lower_bound(b) / 4 + 1);
+		}
+	}
+	for (unsigned k = 2; k < 64; ++k) {
+		const auto power = uint64_t(1) << k;
+		REQUIRE(histogram::lower_bound(histogram::bucket(power)) == power);
+		REQUIRE(histogram::bucket(power - 1) + 1 == histogram::bucket(power));
+	}
+	REQUIRE(histogram::bucket(UINT64_MAX) == histogram::buckets - 1);
+}
+
+TEST_CASE("snapshots sum histograms and read quantiles off them", "[metrics]") {
+	siesta::histogram a, b;
+	for (uint64_t v = 1; v <= 1000; ++v) {
+		(v % 2 ? a : b).record(v * 1000);
+	}
+	siesta::histogram_snapshot s;
+	s.add(a);
+	s.add(b);
+	REQUIRE(s.count == 1000);
+	REQUIRE(s.sum == 500500 * 1000);
+	REQUIRE(s.quantile(0) == siesta::histogram::lower_bound(siesta::histogram::bucket(1000)));
+	const auto p50 = s.quantile(0.5);
+	REQUIRE(p50 <= 500000);
+	REQUIRE(p50 > 500000 * 3 / 4);
+	const auto p99 = s.quantile(0.99);
+	REQUIRE(p99 <= 990000);
+	REQUIRE(p99 > 990000 * 3 / 4);
+	REQUIRE(s.count_below(1024) == 1);
+	REQUIRE(s.count_below(uint64_t(1) << 20) == 1000);
+	REQUIRE(siesta::histogram_snapshot{}.quantile(0.5) == 0);
+}
+
+TEST_CASE("every thread records into its own block", "[metrics]") {
+	siesta::request_metrics metrics(2);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([&] {
+			for (int i = 0; i < 1000; ++i) {
+				metrics.record({1, 100, 2000, 300, 512, i % 10 == 0 ? 500u : 200u});
+			}
+			metrics.count_connection();
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	metrics.count_timeout();
+	const auto snapshot = metrics.collect();
+	REQUIRE(snapshot.endpoints.size() == 2);
+	REQUIRE(snapshot.endpoints[0].handler_ns.count == 0);
+	const auto& e = snapshot.endpoints[1];
+	REQUIRE(e.handler_ns.count == 4000);
+	REQUIRE(e.bytes.sum == 4000 * 512);
+	REQUIRE(e.responses[1] == 3600);
+	REQUIRE(e.responses[4] == 400);
+	REQUIRE(snapshot.connections == 4);
+	REQUIRE(snapshot.timeouts == 1);
+}
+
+TEST_CASE("snapshots render in the Prometheus text format", "[metrics]") {
+	siesta::request_metrics metrics(3);
+	metrics.record({2, 1500, 2'000'000, 4096, 100, 404});
+	metrics.count_connection();
+	static constexpr std::array<std::string_view, 3> names{"other", "list_pets", "get_pet"};
+	std::string out;
+	siesta::render_prometheus(out, metrics.collect(), names);
+
+	REQUIRE(out.find("# TYPE siesta_request_handler_seconds histogram\n") != std::string::npos);
+	REQUIRE(out.find("siesta_request_handler_seconds_bucket{endpoint=\"get_pet\",le=\"0.001048575\"} 0\n") !=
+	        std::string::npos);
+	REQUIRE(out.find("siesta_request_handler_seconds_bucket{endpoint=\"get_pet\",le=\"0.002097151\"} 1\n") !=
+	        std::string::npos);
+	REQUIRE(out.find("siesta_request_handler_seconds_bucket{endpoint=\"get_pet\",le=\"+Inf\"} 1\n") !=
+	        std::string::npos);
+	REQUIRE(out.find("siesta_request_handler_seconds_sum{endpoint=\"get_pet\"} 0.002\n") != std::string::npos);
+	REQUIRE(out.find("siesta_response_bytes_bucket{endpoint=\"get_pet\",le=\"63\"} 0\n") != std::string::npos);
+	REQUIRE(out.find("siesta_response_bytes_bucket{endpoint=\"get_pet\",le=\"255\"} 1\n") != std::string::npos);
+	REQUIRE(out.find("siesta_responses_total{endpoint=\"get_pet\",code=\"4xx\"} 1\n") != std::string::npos);
+	REQUIRE(out.find("siesta_connections_total 1\n") != std::string::npos);
+	// Endpoints without requests are left out.
+	REQUIRE(out.find("list_pets") == std::string::npos);
+	REQUIRE(out.find("endpoint=\"other\"") == std::string::npos);
+}
+
+TEST_CASE("values on a power of two land above the bound below it", "[metrics]") {
+	siesta::request_metrics metrics(2);
+	metrics.record({1, 1024, 1024, 1024, 256, 200});
+	static constexpr std::array<std::string_view, 2> names{"other", "echo"};
+	std::string out;
+	siesta::render_prometheus(out, metrics.collect(), names);
+	// Bounds are inclusive: 256 bytes is counted by le="1023", not by le="255".
+	REQUIRE(out.find("siesta_response_bytes_bucket{endpoint=\"echo\",le=\"255\"} 0\n") != std::string::npos);
+	REQUIRE(out.find("siesta_response_bytes_bucket{endpoint=\"echo\",le=\"1023\"} 1\n") != std::string::npos);
+	REQUIRE(out.find("siesta_request_read_seconds_bucket{endpoint=\"echo\",le=\"1.023e-06\"} 0\n") !=
+	        std::string::npos);
+	REQUIRE(out.find("siesta_request_read_seconds_bucket{endpoint=\"echo\",le=\"2.047e-06\"} 1\n") !=
+	        std::string::npos);
+}
@@ -0,0 +1,193 @@
+// SPDX-License-Identifier: Apache-2.0
+#include <catch2/catch_all.hpp>
+#include <siesta/beast/server.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace asio = ::boost::asio;
+namespace http = ::boost::beast::http;
+using local = asio::local::stream_protocol;
+
+namespace {
+
+class Server : public siesta::beast::ServerBase {
+public:
+	using ServerBase::ServerBase;
+
+	void handle_request(request&, Session::Ptr session) override {
+		auto& res = session->get_response();
+		res.result(http::status::ok);
+		res.body() = "ok";
+		session->write();
+	}
+};
+
+// Answers with a compressible body and the Vary its target names, if any.
+class VaryServer : public siesta::beast::ServerBase {
+public:
+	using ServerBase::ServerBase;
+
+	void handle_request(request& req, Session::Ptr session) override {
+		auto& res = session->get_response();
+		res.result(http::status::ok);
+		if (const auto vary = std::string_view(req.target()).substr(1); !vary.empty()) {
+			res.set(http::field::vary, {vary.data(), vary.size()});
+		}
+		res.body() = std::string(4096, 'a');
+		session->write();
+	}
+};
+
+// Answers with the status its target names, with static header lines like a generated endpoint's.
+class StatusServer : public siesta::beast::ServerBase {
+public:
+	using ServerBase::ServerBase;
+
+	static constexpr std::string_view lines = "Content-Type: text/plain\r\nServer: siesta\r\n";
+	static constexpr HeaderBlock block{lines, 26};
+
+	void handle_request(request& req, Session::Ptr session) override {
+		auto& res = session->get_response();
+		const auto status = std::stoi(std::string(std::string_view(req.target()).substr(1)));
+		res.result(static_cast<http::status>(status));
+		if (status == 304) {
+			res.set(http::field::content_length, "5");
+		} else if (status != 204) {
+			res.body() = "hello";
+		}
+		session->static_headers(block);
+		session->write();
+	}
+};
+
+std::string socket_path(std::string_view name) {
+	return "/tmp/siesta-" + std::string(name) + "-" + std::to_string(::getpid()) + ".sock";
+}
+
+} // namespace
+
+TEST_CASE("a server destroyed with connections open leaves its io_context clean", "[server]") {
+	const auto path = socket_path("server");
+	asio::io_context ctx;
+	auto server = std::make_unique<Server>(ctx, Server::Config{.threads = 2});
+	server->start(local::endpoint(path));
+	std::thread thread([&ctx] { ctx.run(); });
+
+	// Idle after a request, halfway through a header, and halfway through a body, on both shards.
+	asio::io_context client_ctx;
+	std::vector<local::socket> clients;
+	for (int i = 0; i < 12; ++i) {
+		auto& client = clients.emplace_back(client_ctx);
+		client.connect(local::endpoint(path));
+		switch (i % 3) {
+		case 0: {
+			http::request<http::empty_body> req{http::verb::get, "/", 11};
+			http::write(client, req);
+			::boost::beast::flat_buffer buffer;
+			http::response<http::string_body> res;
+			http::read(client, buffer, res);
+			REQUIRE(res.body() == "ok");
+			break;
+		}
+		case 1:
+			asio::write(client, asio::buffer(std::string_view("GET / HTTP/1.1\r\nHost: loc")));
+			break;
+		default:
+			asio::write(client, asio::buffer(std::string_view("POST / HTTP/1.1\r\nContent-Length: 10\r\n\r\nabc")));
+			break;
+		}
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds{50});
+	REQUIRE(server->admission_stats().connections == clients.size());
+
+	ctx.stop();
+	thread.join();
+	server.reset();
+
+	// Every connection was closed, and nothing the server left in the io_context refers to it.
+	for (auto& client : clients) {
+		std::array<char, 64> buffer;
+		::boost::system::error_code ec;
+		client.read_some(asio::buffer(buffer), ec);
+		REQUIRE(ec == asio::error::eof);
+	}
+	ctx.restart();
+	REQUIRE(ctx.poll() == 0);
+}
+
+TEST_CASE("a compressed response lists Accept-Encoding in one Vary field", "[server]") {
+	const auto path = socket_path("vary");
+	asio::io_context ctx;
+	VaryServer server(ctx, VaryServer::Config{.compress_min_size = 256});
+	server.start(local::endpoint(path));
+	std::thread thread([&ctx] { ctx.run(); });
+
+	asio::io_context client_ctx;
+	local::socket client(client_ctx);
+	client.connect(local::endpoint(path));
+	::boost::beast::flat_buffer buffer;
+	auto vary = [&](std::string_view handler_vary) {
+		http::request<http::empty_body> req{http::verb::get, "/" + std::string(handler_vary), 11};
+		req.set(http::field::accept_encoding, "gzip");
+		http::write(client, req);
+		http::response<http::string_body> res;
+		http::read(client, buffer, res);
+		REQUIRE(res[http::field::content_encoding] == "gzip");
+		REQUIRE(res.count(http::field::vary) == 1);
+		return std::string(res[http::field::vary]);
+	};
+	REQUIRE(vary("") == "Accept-Encoding");
+	REQUIRE(vary("Origin") == "Origin, Accept-Encoding");
+	REQUIRE(vary("Origin,accept-encoding") == "Origin,accept-encoding");
+	REQUIRE(vary("*") == "*");
+
+	ctx.stop();
+	thread.join();
+	server.stop();
+}
+
+TEST_CASE("answers without a body keep the static header lines", "[server]") {
+	const auto path = socket_path("status");
+	asio::io_context ctx;
+	StatusServer server(ctx, StatusServer::Config{});
+	server.start(local::endpoint(path));
+	std::thread thread([&ctx] { ctx.run(); });
+
+	asio::io_context client_ctx;
+	local::socket client(client_ctx);
+	client.connect(local::endpoint(path));
+	::boost::beast::flat_buffer buffer;
+	// Every field but Date, in order.
+	auto fields = [&](http::verb method, std::string target) {
+		http::write(client, http::request<http::empty_body>{method, target, 11});
+		http::response_parser<http::string_body> parser;
+		parser.skip(method == http::verb::head);
+		http::read(client, buffer, parser);
+		std::string out;
+		for (const auto& field : parser.get()) {
+			if (field.name() != http::field::date) {
+				const auto name = field.name_string();
+				const auto value = field.value();
+				out.append(name.data(), name.size()).append(": ").append(value.data(), value.size()).append("\n");
+			}
+		}
+		REQUIRE(parser.get().body().empty() == (method == http::verb::head || target != "/200"));
+		return out;
+	};
+	const auto get = fields(http::verb::get, "/200");
+	REQUIRE(get == "Content-Length: 5\nContent-Type: text/plain\nServer: siesta\n");
+	REQUIRE(fields(http::verb::head, "/200") == get);
+	REQUIRE(fields(http::verb::get, "/204") == "Content-Type: text/plain\nServer: siesta\n");
+	REQUIRE(fields(http::verb::get, "/304") == get);
+
+	ctx.stop();
+	thread.join();
+	server.stop();
+}
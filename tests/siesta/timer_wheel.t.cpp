@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: Apache-2.0
+#include <catch2/catch_all.hpp>
+#include <siesta/timer_wheel.hpp>
+
+#include <map>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct Timer : siesta::timer_wheel_hook {
+	int id = 0;
+};
+
+// Advances one tick at a time and records the tick each timer fired at.
+std::map<int, uint64_t> run(siesta::timer_wheel& wheel, uint64_t until) {
+	std::map<int, uint64_t> fired;
+	for (uint64_t t = wheel.now() + 1; t <= until; ++t) {
+		wheel.advance(t, [&](siesta::timer_wheel_hook& hook) {
+			fired[static_cast<Timer&>(hook).id] = t;
+		});
+	}
+	return fired;
+}
+
+} // namespace
+
+TEST_CASE("timers fire at their tick on every level", "[timer_wheel]") {
+	siesta::timer_wheel wheel;
+	const std::vector<uint64_t> expiries = {1, 2, 63, 64, 65, 4095, 4096, 4097, 262143, 262144, 300001};
+	std::vector<Timer> timers(expiries.size());
+	for (std::size_t i = 0; i < timers.size(); ++i) {
+		timers[i].id = int(i);
+		wheel.schedule(timers[i], expiries[i]);
+	}
+	const auto fired = run(wheel, 300001);
+	REQUIRE(fired.size() == expiries.size());
+	for (std::size_t i = 0; i < expiries.size(); ++i) {
+		CHECK(fired.at(int(i)) == expiries[i]);
+		CHECK_FALSE(timers[i].linked());
+	}
+	CHECK(wheel.empty());
+}
+
+TEST_CASE("timers beyond the top level are parked until in range", "[timer_wheel]") {
+	siesta::timer_wheel wheel;
+	constexpr uint64_t range = uint64_t(1) << (siesta::timer_wheel::slot_bits * siesta::timer_wheel::levels);
+	Timer far;
+	wheel.schedule(far, range + 1000);
+	wheel.advance(range + 999, [](siesta::timer_wheel_hook&) { FAIL("fired early"); });
+	CHECK(far.linked());
+	bool fired = false;
+	wheel.advance(range + 1000, [&](siesta::timer_wheel_hook&) { fired = true; });
+	CHECK(fired);
+}
+
+TEST_CASE("rescheduling and unlinking", "[timer_wheel]") {
+	siesta::timer_wheel wheel;
+	Timer a, b;
+	a.id = 1;
+	b.id = 2;
+	wheel.schedule(a, 10);
+	wheel.schedule(b, 10);
+	wheel.schedule(a, 5000);
+	b.unlink();
+	CHECK(run(wheel, 4999).empty());
+	CHECK(run(wheel, 5000) == std::map<int, uint64_t>{{1, 5000}});
+
+	// Past ticks expire on the next one.
+	wheel.schedule(a, 1);
+	CHECK(run(wheel, 5001) == std::map<int, uint64_t>{{1, 5001}});
+
+	// Destroying a scheduled hook takes it off the wheel.
+	{
+		Timer c;
+		wheel.schedule(c, 6000);
+	}
+	CHECK(wheel.empty());
+}
+
+TEST_CASE("jumping ahead expires everything due", "[timer_wheel]") {
+	siesta::timer_wheel wheel;
+	std::mt19937_64 rng(42);
+	std::vector<Timer> timers(1000);
+	for (auto& timer : timers) {
+		wheel.schedule(timer, 1 + rng() % 100000);
+	}
+	std::size_t count = 0;
+	wheel.advance(50000, [&](siesta::timer_wheel_hook& hook) {
+		CHECK(hook.expiry() <= 50000);
+		++count;
+	});
+	for (const auto& timer : timers) {
+		CHECK(timer.linked() == (timer.expiry() > 50000));
+	}
+	wheel.advance(100000, [&](siesta::timer_wheel_hook&) { ++count; });
+	CHECK(count == timers.size());
+	CHECK(wheel.empty());
+}
+
+TEST_CASE("the expiry callback may re-arm", "[timer_wheel]") {
+	siesta::timer_wheel wheel;
+	Timer a;
+	wheel.schedule(a, 3);
+	std::vector<uint64_t> ticks;
+	wheel.advance(20, [&](siesta::timer_wheel_hook& hook) {
+		ticks.push_back(wheel.now());
+		if (ticks.size() < 3) {
+			wheel.schedule(hook, wheel.now() + 5);
+		}
+	});
+	CHECK(ticks == std::vector<uint64_t>{3, 8, 13});
+}
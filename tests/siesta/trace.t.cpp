@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: Apache-2.0
+#include <catch2/catch_all.hpp>
+#include <siesta/trace.hpp>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace {
+
+bool has_span(const std::string& json, uint64_t id) {
+	const auto key = "\"args\":{\"id\":" + std::to_string(id);
+	return json.find(key + "}") != std::string::npos || json.find(key + ",") != std::string::npos;
+}
+
+} // namespace
+
+TEST_CASE("one call in N is sampled", "[trace]") {
+	for (int i = 0; i < 10; ++i) {
+		REQUIRE_FALSE(siesta::trace_sample(0));
+	}
+	int sampled = 0;
+	for (int i = 0; i < 400; ++i) {
+		sampled += siesta::trace_sample(4);
+	}
+	REQUIRE(sampled == 100);
+	REQUIRE(siesta::trace_sample(1));
+	REQUIRE(siesta::trace_sample(1));
+}
+
+TEST_CASE("spans render as Chrome trace events", "[trace]") {
+	const auto id = siesta::next_trace_id();
+	const siesta::trace_clock::time_point begin{std::chrono::nanoseconds{5'000'123'456}};
+	siesta::trace_span("server", "handler", id, begin, begin + std::chrono::nanoseconds{2'500}, "get \"pet\"");
+	std::string json;
+	siesta::render_trace(json);
+	REQUIRE(json.starts_with("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+	REQUIRE(json.ends_with("]}\n"));
+	const auto at = json.find("\"args\":{\"id\":" + std::to_string(id) + ",");
+	REQUIRE(at != std::string::npos);
+	const auto event = json.substr(json.rfind('{', at - 1), json.find('\n', at) - json.rfind('{', at - 1));
+	REQUIRE(event.find("\"name\":\"handler\",\"cat\":\"server\",\"ph\":\"X\"") != std::string::npos);
+	REQUIRE(event.find("\"ts\":5000123.456,\"dur\":2.500") != std::string::npos);
+	REQUIRE(event.find("\"detail\":\"get \\\"pet\\\"\"") != std::string::npos);
+}
+
+TEST_CASE("a full ring keeps its newest spans", "[trace]") {
+	const auto first = siesta::next_trace_id();
+	std::thread([&] {
+		const auto now = siesta::trace_clock::now();
+		for (uint64_t i = 0; i < siesta::trace_ring_size + 10; ++i) {
+			siesta::trace_span("client", "call", first + 1'000'000 + i, now, now);
+		}
+	}).join();
+	std::string json;
+	siesta::render_trace(json);
+	for (uint64_t i = 0; i < 10; ++i) {
+		REQUIRE_FALSE(has_span(json, first + 1'000'000 + i));
+	}
+	REQUIRE(has_span(json, first + 1'000'000 + 10));
+	REQUIRE(has_span(json, first + 1'000'000 + siesta::trace_ring_size + 9));
+}
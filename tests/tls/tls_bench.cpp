@@ -0,0 +1,216 @@
+// SPDX-License-Identifier: Apache-2.0
+#include <catch2/catch_all.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/asio/use_future.hpp>
+#include <boost/beast/http.hpp>
+#include <cstdio>
+#include <memory>
+#include <openssl/pem.h>
+#include <openssl/rand.h>
+#include <openssl/x509.h>
+#include <siesta/beast/client.hpp>
+#include <siesta/beast/server.hpp>
+#include <siesta/beast/tls.hpp>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace asio = ::boost::asio;
+namespace http = ::boost::beast::http;
+namespace ssl = ::boost::asio::ssl;
+using local = asio::local::stream_protocol;
+
+namespace {
+
+// A throwaway P-256 certificate for CN=localhost, as PEM.
+struct Certificate {
+	std::string cert;
+	std::string key;
+};
+
+std::string to_pem(auto write) {
+	std::unique_ptr<BIO, decltype(&BIO_free)> bio(BIO_new(BIO_s_mem()), BIO_free);
+	write(bio.get());
+	char* data = nullptr;
+	const auto size = BIO_get_mem_data(bio.get(), &data);
+	return {data, static_cast<std::size_t>(size)};
+}
+
+Certificate self_signed() {
+	std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key(EVP_EC_gen("P-256"), EVP_PKEY_free);
+	std::unique_ptr<X509, decltype(&X509_free)> x509(X509_new(), X509_free);
+	X509_set_version(x509.get(), 2);
+	ASN1_INTEGER_set(X509_get_serialNumber(x509.get()), 1);
+	X509_gmtime_adj(X509_getm_notBefore(x509.get()), 0);
+	X509_gmtime_adj(X509_getm_notAfter(x509.get()), 3600);
+	X509_set_pubkey(x509.get(), key.get());
+	auto* name = X509_get_subject_name(x509.get());
+	X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+	X509_set_issuer_name(x509.get(), name);
+	X509_sign(x509.get(), key.get(), EVP_sha256());
+	return {
+		to_pem([&](BIO* bio) { PEM_write_bio_X509(bio, x509.get()); }),
+		to_pem([&](BIO* bio) { PEM_write_bio_PrivateKey(bio, key.get(), nullptr, nullptr, 0, nullptr, nullptr); }),
+	};
+}
+
+class Server : public siesta::beast::ServerBase {
+public:
+	using ServerBase::ServerBase;
+
+	void handle_request(request&, Session::Ptr session) override {
+		auto& res = session->get_response();
+		res.result(http::status::ok);
+		res.body() = "ok";
+		session->write();
+	}
+};
+
+class Client : public siesta::beast::ClientBase {
+public:
+	using ClientBase::ClientBase;
+
+	template <typename CompletionToken>
+	auto get(CompletionToken&& token) {
+		return async_submit_request(request_type{http::verb::get, "/", 11}, std::forward<CompletionToken>(token));
+	}
+};
+
+// A TLS server on a UNIX domain socket, run on its own thread, and a client context trusting it.
+struct Fixture {
+	Certificate certificate;
+	std::string path;
+	ssl::context server_tls{ssl::context::tls_server};
+	ssl::context client_tls{ssl::context::tls_client};
+	asio::io_context server_ctx;
+	Server server{server_ctx};
+	std::thread thread;
+	bool resumed{false}; // whether the last handshake() resumed its session
+
+	explicit Fixture(std::string_view name = "tls", Certificate cert = self_signed(),
+	                 std::vector<siesta::beast::tls_ticket_key> ticket_keys = {})
+		: certificate(std::move(cert))
+		, path("/tmp/siesta-" + std::string(name) + "-" + std::to_string(::getpid()) + ".sock") {
+		siesta::beast::configure_server_tls(server_tls);
+		siesta::beast::use_ticket_keys(server_tls, std::move(ticket_keys));
+		server_tls.use_certificate_chain(asio::buffer(certificate.cert));
+		server_tls.use_private_key(asio::buffer(certificate.key), ssl::context::pem);
+		client_tls.add_certificate_authority(asio::buffer(certificate.cert));
+		client_tls.set_verify_mode(ssl::verify_peer);
+		server.use_tls(server_tls);
+		server.start(local::endpoint(path));
+		thread = std::thread([this] { server_ctx.run(); });
+	}
+	~Fixture() {
+		server_ctx.stop();
+		thread.join();
+		server.stop();
+	}
+
+	// One synchronous handshake, offering `session` when given; returns the resulting session.
+	SSL_SESSION* handshake(SSL_SESSION* session, asio::io_context& ctx) {
+		ssl::stream<local::socket> stream(ctx, client_tls);
+		stream.next_layer().connect(local::endpoint(path));
+		if (session != nullptr) {
+			SSL_set_session(stream.native_handle(), session);
+		}
+		stream.handshake(ssl::stream_base::client);
+		// TLS 1.3 tickets follow the handshake; a request and its response make sure one arrived.
+		http::request<http::empty_body> req{http::verb::get, "/", 11};
+		req.set(http::field::host, "localhost");
+		http::write(stream, req);
+		::boost::beast::flat_buffer buffer;
+		http::response<http::string_body> res;
+		http::read(stream, buffer, res);
+		resumed = SSL_session_reused(stream.native_handle()) == 1;
+		// Freeing an SSL that was not shut down marks its session as not resumable.
+		SSL_set_shutdown(stream.native_handle(), SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+		return SSL_get1_session(stream.native_handle());
+	}
+};
+
+} // namespace
+
+TEST_CASE("requests are served over TLS and reconnects resume the session", "[tls]") {
+	Fixture fixture;
+	asio::io_context ctx;
+	auto client = std::make_shared<Client>(ctx);
+	client->use_tls(fixture.client_tls, "localhost");
+
+	for (int connection = 0; connection < 2; ++connection) {
+		INFO("connection " << connection);
+		client->start(local::endpoint(fixture.path));
+		ctx.restart();
+		ctx.run();
+		auto future = client->get(asio::use_future);
+		ctx.restart();
+		ctx.run();
+		auto outcome = future.get();
+		REQUIRE(outcome.has_value());
+		REQUIRE(outcome.value().body() == "ok");
+		REQUIRE(client->tls_resumed() == (connection == 1));
+		client->stop();
+	}
+}
+
+TEST_CASE("servers sharing ticket keys resume each other's sessions", "[tls]") {
+	std::vector<siesta::beast::tls_ticket_key> keys(1);
+	REQUIRE(RAND_bytes(keys[0].data(), keys[0].size()) == 1);
+	const auto certificate = self_signed();
+	asio::io_context ctx;
+	std::unique_ptr<SSL_SESSION, decltype(&SSL_SESSION_free)> session(nullptr, SSL_SESSION_free);
+	{
+		Fixture first("tls-first", certificate, keys);
+		session.reset(first.handshake(nullptr, ctx));
+		REQUIRE_FALSE(first.resumed);
+	}
+
+	// A server started after the first one is gone, with an empty session cache of its own.
+	Fixture second("tls-second", certificate, keys);
+	SSL_SESSION_free(second.handshake(session.get(), ctx));
+	REQUIRE(second.resumed);
+
+	// One that does not know the key falls back to a full handshake.
+	Fixture other("tls-other", certificate);
+	SSL_SESSION_free(other.handshake(session.get(), ctx));
+	REQUIRE_FALSE(other.resumed);
+}
+
+TEST_CASE("a ticket key is read from an 80-byte file", "[tls]") {
+	const auto path = "/tmp/siesta-ticket-" + std::to_string(::getpid()) + ".key";
+	auto write = [&](std::size_t size) {
+		std::unique_ptr<std::FILE, decltype(&std::fclose)> out(std::fopen(path.c_str(), "wb"), std::fclose);
+		for (std::size_t i = 0; i < size; ++i) {
+			std::fputc(static_cast<int>(i), out.get());
+		}
+	};
+	write(80);
+	const auto key = siesta::beast::load_ticket_key(path);
+	REQUIRE(key.has_value());
+	REQUIRE((*key)[79] == 79);
+	write(81);
+	REQUIRE_FALSE(siesta::beast::load_ticket_key(path).has_value());
+	write(79);
+	REQUIRE_FALSE(siesta::beast::load_ticket_key(path).has_value());
+	::unlink(path.c_str());
+	REQUIRE_FALSE(siesta::beast::load_ticket_key(path).has_value());
+}
+
+TEST_CASE("handshake cost, full and resumed", "[tls][benchmark]") {
+	Fixture fixture;
+	asio::io_context ctx;
+	std::unique_ptr<SSL_SESSION, decltype(&SSL_SESSION_free)> session(fixture.handshake(nullptr, ctx), SSL_SESSION_free);
+	REQUIRE(SSL_SESSION_is_resumable(session.get()) == 1);
+
+	BENCHMARK("full handshake + request") {
+		SSL_SESSION_free(fixture.handshake(nullptr, ctx));
+	};
+	BENCHMARK("resumed handshake + request") {
+		SSL_SESSION_free(fixture.handshake(session.get(), ctx));
+	};
+}